@@ -32,11 +32,44 @@
 #include "jobs/roommessagesjob.h"
 #include "jobs/syncjob.h"
 #include "jobs/mediathumbnailjob.h"
+#include "jobs/mediadownloadjob.h"
+#include "jobs/mediauploadjob.h"
+#include "jobs/jobscheduler.h"
+#include "filter.h"
+#include "mediacache.h"
+#include "jsonstorage.h"
 
+#include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSaveFile>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
 
 using namespace QMatrixClient;
 
+class InvokeEvent: public QEvent
+{
+    public:
+        static QEvent::Type eventType()
+        {
+            static const int type = QEvent::registerEventType();
+            return QEvent::Type(type);
+        }
+
+        InvokeEvent(std::function<void()> f)
+            : QEvent(eventType()), function(f)
+        { }
+
+        std::function<void()> function;
+};
+
 Connection::Connection(QUrl server, QObject* parent)
     : QObject(parent)
 {
@@ -44,6 +77,13 @@ Connection::Connection(QUrl server, QObject* parent)
     d->data = new ConnectionData(server);
 }
 
+Connection::Connection(QUrl server, QNetworkAccessManager* nam, QObject* parent)
+    : QObject(parent)
+{
+    d = new ConnectionPrivate(this);
+    d->data = new ConnectionData(server, nam);
+}
+
 Connection::Connection()
     : Connection(QUrl("https://matrix.org"))
 {
@@ -98,23 +138,75 @@ void Connection::reconnect()
     loginJob->start();
 }
 
+static const int SyncRetryDelay = 5 * 1000;
+
 SyncJob* Connection::sync(int timeout)
 {
-    QString filter = "{\"room\": { \"timeline\": { \"limit\": 100 } } }";
     SyncJob* syncJob = new SyncJob(d->data, d->data->lastEvent());
-    syncJob->setFilter(filter);
+    syncJob->setFilter(d->syncFilterParam());
     syncJob->setTimeout(timeout);
+    syncJob->setParseInBackground(true);
     connect( syncJob, &SyncJob::success, [=] () {
         d->data->setLastEvent(syncJob->nextBatch());
+        if( syncJob == d->syncLoopJob )
+        {
+            // Have the next batch on its way while this one is processed
+            d->syncLoopJob = nullptr;
+            d->syncLoopIteration();
+        }
         d->processRooms(syncJob->roomData());
         emit syncDone();
     });
-    connect( syncJob, &SyncJob::failure,
-             [=] () { emit connectionError(syncJob->errorString());});
+    connect( syncJob, &SyncJob::failure, [=] () {
+        if( syncJob == d->syncLoopJob )
+        {
+            d->syncLoopJob = nullptr;
+            QTimer::singleShot(SyncRetryDelay, d, SLOT(syncLoopIteration()));
+        }
+        emit connectionError(syncJob->errorString());
+    });
     syncJob->start();
     return syncJob;
 }
 
+void Connection::startSyncLoop()
+{
+    d->syncLoopActive = true;
+    d->syncLoopPaused = false;
+    d->syncLoopIteration();
+}
+
+void Connection::stopSyncLoop()
+{
+    d->syncLoopActive = false;
+    if( d->syncLoopJob )
+    {
+        d->syncLoopJob->kill();
+        d->syncLoopJob = nullptr;
+    }
+}
+
+void Connection::pauseSyncLoop()
+{
+    d->syncLoopPaused = true;
+}
+
+void Connection::resumeSyncLoop()
+{
+    d->syncLoopPaused = false;
+    d->syncLoopIteration();
+}
+
+void Connection::setSyncTimeout(int timeout)
+{
+    d->syncTimeout = timeout;
+}
+
+int Connection::syncTimeout() const
+{
+    return d->syncTimeout;
+}
+
 void Connection::postMessage(Room* room, QString type, QString message)
 {
     PostMessageJob* job = new PostMessageJob(d->data, room, type, message);
@@ -147,6 +239,7 @@ void Connection::leaveRoom(Room* room)
 void Connection::getMembers(Room* room)
 {
     RoomMembersJob* job = new RoomMembersJob(d->data, room);
+    job->setParseInBackground(true);
     connect( job, &RoomMembersJob::result, d, &ConnectionPrivate::gotRoomMembers );
     job->start();
 }
@@ -154,13 +247,38 @@ void Connection::getMembers(Room* room)
 RoomMessagesJob* Connection::getMessages(Room* room, QString from)
 {
     RoomMessagesJob* job = new RoomMessagesJob(d->data, room, from);
+    job->setParseInBackground(true);
     job->start();
     return job;
 }
 
 MediaThumbnailJob* Connection::getThumbnail(QUrl url, int requestedWidth, int requestedHeight)
 {
+    const QString key =
+        MediaCache::thumbnailKey(url, requestedWidth, requestedHeight, "scale");
+    if( MediaThumbnailJob* job = d->thumbnailJobs.value(key) )
+    {
+        job->addRequester();
+        return job;
+    }
+
     MediaThumbnailJob* job = new MediaThumbnailJob(d->data, url, requestedWidth, requestedHeight);
+    d->thumbnailJobs.insert(key, job);
+    connect( job, &KJob::finished, this, [=] () { d->thumbnailJobs.remove(key); });
+    job->start();
+    return job;
+}
+
+MediaDownloadJob* Connection::downloadMedia(QUrl url, QString localFilePath)
+{
+    MediaDownloadJob* job = new MediaDownloadJob(d->data, url, localFilePath);
+    job->start();
+    return job;
+}
+
+MediaUploadJob* Connection::uploadContent(QIODevice* source, QString contentType, QString fileName)
+{
+    MediaUploadJob* job = new MediaUploadJob(d->data, source, contentType, fileName);
     job->start();
     return job;
 }
@@ -191,6 +309,145 @@ QString Connection::token()
     return d->data->token();
 }
 
+static const int StateCacheVersion = 1;
+
+void Connection::saveState(QUrl toFile, int timelineLimit)
+{
+    QString filePath = toFile.isEmpty() ? stateCachePath() + "state"
+                                        : toFile.toLocalFile();
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    QJsonObject joinedRooms;
+    QJsonObject invitedRooms;
+    QJsonObject leftRooms;
+    for( Room* room: d->roomMap )
+    {
+        switch( room->joinState() )
+        {
+            case JoinState::Join:
+                joinedRooms.insert(room->id(), room->toJson(timelineLimit));
+                break;
+            case JoinState::Invite:
+                invitedRooms.insert(room->id(), room->toJson(timelineLimit));
+                break;
+            case JoinState::Leave:
+                leftRooms.insert(room->id(), room->toJson(timelineLimit));
+                break;
+        }
+    }
+    QJsonObject rooms;
+    rooms.insert("join", joinedRooms);
+    rooms.insert("invite", invitedRooms);
+    rooms.insert("leave", leftRooms);
+
+    QJsonObject state;
+    state.insert("version", StateCacheVersion);
+    state.insert("user_id", d->userId);
+    state.insert("next_batch", d->data->lastEvent());
+    state.insert("rooms", rooms);
+
+    // Least recently used first, to be added back in the same order
+    QJsonArray uploadedContent;
+    for( const auto& upload: d->data->uploadedContent() )
+    {
+        QJsonObject item;
+        item.insert("hash", QString::fromLatin1(upload.first.toHex()));
+        item.insert("content_uri", upload.second.toString());
+        uploadedContent.append(item);
+    }
+    state.insert("uploaded_content", uploadedContent);
+
+    QSaveFile file(filePath);
+    if( !file.open(QIODevice::WriteOnly) )
+    {
+        qDebug() << "Can't save the state to" << filePath << ":" << file.errorString();
+        return;
+    }
+    file.write(toStoredJson(state));
+    if( !file.commit() )
+        qDebug() << "Can't save the state to" << filePath << ":" << file.errorString();
+}
+
+void Connection::loadState(QUrl fromFile)
+{
+    QString filePath = fromFile.isEmpty() ? stateCachePath() + "state"
+                                          : fromFile.toLocalFile();
+    QFile file(filePath);
+    if( !file.open(QIODevice::ReadOnly) )
+        return;
+    const QJsonObject state = fromStoredJson(file.readAll());
+    if( state.value("version").toInt() != StateCacheVersion ||
+        state.value("user_id").toString() != d->userId )
+    {
+        qDebug() << "Ignoring the state cache in" << filePath;
+        return;
+    }
+
+    const QJsonObject rooms = state.value("rooms").toObject();
+    const struct { QString key; JoinState state; } joinStates[] = {
+        { "join", JoinState::Join },
+        { "invite", JoinState::Invite },
+        { "leave", JoinState::Leave }
+    };
+    QList<SyncRoomData> roomData;
+    for( const auto& joinState: joinStates )
+    {
+        const QJsonObject roomsOfState = rooms.value(joinState.key).toObject();
+        for( auto it = roomsOfState.begin(); it != roomsOfState.end(); ++it )
+            roomData.append(SyncRoomData(it.key(), it.value().toObject(), joinState.state));
+    }
+    const QJsonArray uploadedContent = state.value("uploaded_content").toArray();
+    for( const QJsonValue& upload: uploadedContent )
+    {
+        const QJsonObject item = upload.toObject();
+        d->data->addUploadedContent(QByteArray::fromHex(item.value("hash").toString().toLatin1()),
+                                    QUrl(item.value("content_uri").toString()));
+    }
+
+    d->data->setLastEvent(state.value("next_batch").toString());
+    d->processRooms(roomData);
+}
+
+QString Connection::stateCachePath()
+{
+    QString userDir = d->userId;
+    userDir.replace(':', '_');
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/" + userDir + "/";
+}
+
+void Connection::setEventLogEnabled(bool enabled)
+{
+    d->eventLogEnabled = enabled;
+}
+
+bool Connection::eventLogEnabled() const
+{
+    return d->eventLogEnabled;
+}
+
+void Connection::setMaxResidentEvents(int maxEvents)
+{
+    d->maxResidentEvents = maxEvents;
+}
+
+int Connection::maxResidentEvents() const
+{
+    return d->maxResidentEvents;
+}
+
+void Connection::setSyncFilter(const Filter& filter)
+{
+    d->syncFilter = filter;
+    d->syncFilterId.clear();
+    d->filterUploadFailures = 0;
+}
+
+Filter Connection::syncFilter() const
+{
+    return d->syncFilter;
+}
+
 QHash< QString, Room* > Connection::roomMap() const
 {
     return d->roomMap;
@@ -206,6 +463,62 @@ ConnectionData* Connection::connectionData()
     return d->data;
 }
 
+QThread* Connection::moveToWorkerThread()
+{
+    if( parent() )
+    {
+        qWarning() << "Connection: can't move a connection with a parent to a worker thread";
+        return nullptr;
+    }
+    if( !d->data->canMoveToThread() )
+    {
+        qWarning() << "Connection: can't move the network access manager"
+                   << "given to the connection to a worker thread";
+        return nullptr;
+    }
+    // Jobs keep running in the calling thread and touch the connection
+    // from there
+    if( d->data->scheduler()->hasJobs() || !d->thumbnailJobs.isEmpty() )
+    {
+        qWarning() << "Connection: can't move a connection with jobs running to a worker thread";
+        return nullptr;
+    }
+    QThread* thread = new QThread();
+    thread->setObjectName("Connection");
+    moveToThread(thread);
+    d->moveToThread(thread);
+    d->data->moveToThread(thread);
+    connect( this, &QObject::destroyed, thread, &QThread::quit, Qt::DirectConnection );
+    connect( thread, &QThread::finished, thread, &QObject::deleteLater );
+    thread->start();
+    return thread;
+}
+
+void Connection::invoke(std::function<void()> f)
+{
+    QCoreApplication::postEvent(this, new InvokeEvent(f));
+}
+
+void Connection::setUpdateBatchInterval(int msec)
+{
+    d->roomsUpdatedTimer.setInterval(msec);
+}
+
+int Connection::updateBatchInterval() const
+{
+    return d->roomsUpdatedTimer.interval();
+}
+
+bool Connection::event(QEvent* e)
+{
+    if( e->type() == InvokeEvent::eventType() )
+    {
+        static_cast<InvokeEvent*>(e)->function();
+        return true;
+    }
+    return QObject::event(e);
+}
+
 User* Connection::createUser(QString userId)
 {
     return new User(userId, this);
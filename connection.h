@@ -20,6 +20,13 @@
 #define QMATRIXCLIENT_CONNECTION_H
 
 #include <QtCore/QObject>
+#include <QtCore/QStringList>
+
+#include <functional>
+
+class QIODevice;
+class QNetworkAccessManager;
+class QThread;
 
 namespace QMatrixClient
 {
@@ -33,11 +40,21 @@ namespace QMatrixClient
     class RoomMessagesJob;
     class PostReceiptJob;
     class MediaThumbnailJob;
+    class MediaDownloadJob;
+    class MediaUploadJob;
+    class Filter;
 
     class Connection: public QObject {
             Q_OBJECT
         public:
             Connection(QUrl server, QObject* parent = nullptr);
+            /**
+             * Makes a connection that sends its requests through nam,
+             * e.g. ConnectionData::sharedNetworkAccessManager(), instead
+             * of a network access manager of its own. The connection
+             * doesn't take ownership of nam.
+             */
+            Connection(QUrl server, QNetworkAccessManager* nam, QObject* parent = nullptr);
             Connection();
             virtual ~Connection();
 
@@ -49,19 +66,134 @@ namespace QMatrixClient
             Q_INVOKABLE virtual void connectWithToken( QString userId, QString token );
             Q_INVOKABLE virtual void reconnect();
             Q_INVOKABLE virtual SyncJob* sync(int timeout=-1);
+            /**
+             * Starts syncing continuously: the next sync request is sent
+             * as soon as the previous one returns, before its rooms are
+             * processed. A failed sync is retried after a delay.
+             */
+            Q_INVOKABLE virtual void startSyncLoop();
+            /** Stops the sync loop, cancelling the sync in progress */
+            Q_INVOKABLE virtual void stopSyncLoop();
+            /**
+             * Lets the sync in progress complete but doesn't send another
+             * one until resumeSyncLoop().
+             */
+            Q_INVOKABLE virtual void pauseSyncLoop();
+            Q_INVOKABLE virtual void resumeSyncLoop();
+            /** The long-poll timeout of syncs sent by the loop, in ms */
+            Q_INVOKABLE virtual void setSyncTimeout(int timeout);
+            Q_INVOKABLE virtual int syncTimeout() const;
             Q_INVOKABLE virtual void postMessage( Room* room, QString type, QString message );
             Q_INVOKABLE virtual PostReceiptJob* postReceipt( Room* room, Event* event );
             Q_INVOKABLE virtual void joinRoom( QString roomAlias );
             Q_INVOKABLE virtual void leaveRoom( Room* room );
             Q_INVOKABLE virtual void getMembers( Room* room );
             Q_INVOKABLE virtual RoomMessagesJob* getMessages( Room* room, QString from );
+            /**
+             * Requests a thumbnail of the media. Requests for the same URL
+             * and size made while the first one is in progress get the
+             * same job, so connect to it with a context object of your
+             * own. Killing the job only stops it once every requester
+             * has killed it; until then kill() returns false and the job
+             * goes on for the others (see MediaThumbnailJob::addRequester()).
+             */
             virtual MediaThumbnailJob* getThumbnail( QUrl url, int requestedWidth, int requestedHeight );
+            /** Downloads the media to a file; see MediaDownloadJob */
+            virtual MediaDownloadJob* downloadMedia( QUrl url, QString localFilePath );
+            /** Uploads the content of the device; see MediaUploadJob */
+            virtual MediaUploadJob* uploadContent( QIODevice* source, QString contentType,
+                                                   QString fileName = QString() );
 
             Q_INVOKABLE virtual User* user(QString userId);
             Q_INVOKABLE virtual User* user();
             Q_INVOKABLE virtual QString userId();
             Q_INVOKABLE virtual QString token();
 
+            /**
+             * Saves the sync token, the rooms with their current state and
+             * the last timelineLimit events of each timeline, as well as
+             * the content URIs of uploaded media, to toFile
+             * (stateCachePath() + "state" by default). A client that calls
+             * loadState() on its next start can show its rooms immediately,
+             * and the next sync() only fetches what has changed since.
+             */
+            Q_INVOKABLE virtual void saveState(QUrl toFile = QUrl(), int timelineLimit = 20);
+            /**
+             * Restores what saveState() has saved, creating rooms as if they
+             * came from a sync. A missing, unreadable or foreign (another
+             * user's) file is ignored and the next sync() starts from scratch.
+             * Call it after connectWithToken() and before the first sync().
+             */
+            Q_INVOKABLE virtual void loadState(QUrl fromFile = QUrl());
+            /**
+             * The directory where the connection keeps its caches, specific
+             * to the logged in user; ends with a slash.
+             */
+            Q_INVOKABLE virtual QString stateCachePath();
+
+            /**
+             * Makes rooms keep every event they receive in an event log
+             * under stateCachePath(), so that getPreviousContent() can
+             * serve history seen before from disk. Off by default;
+             * affects rooms that haven't received events yet.
+             */
+            Q_INVOKABLE virtual void setEventLogEnabled(bool enabled);
+            Q_INVOKABLE virtual bool eventLogEnabled() const;
+            /**
+             * Limits the number of events each room keeps in memory; after
+             * a sync the oldest events beyond the limit are dropped and
+             * getPreviousContent() brings them back from the event log.
+             * Only has effect with the event log enabled. 0 (the default)
+             * means no limit. Events from Room::pinnedEvent() on are
+             * never dropped.
+             */
+            Q_INVOKABLE virtual void setMaxResidentEvents(int maxEvents);
+            Q_INVOKABLE virtual int maxResidentEvents() const;
+
+            /**
+             * Sets the filter for sync(). The filter is uploaded to the
+             * server once and referred to by its id afterwards; until the
+             * upload completes it is sent inline. Failed uploads are
+             * retried with the following syncs, after a delay growing from
+             * 30 seconds to an hour.
+             * By default only the timeline is limited to 100 events.
+             */
+            virtual void setSyncFilter(const Filter& filter);
+            virtual Filter syncFilter() const;
+
+            /**
+             * Moves the connection, its rooms and users and the objects
+             * behind its jobs to a new thread and starts it, so that
+             * syncs are processed off the calling thread. Call it right
+             * after construction, before any jobs are started. The
+             * connection then can't have a parent; it has to be deleted
+             * with deleteLater(), which also stops and deletes the thread.
+             * Returns nullptr and leaves the connection where it is if it
+             * has a parent or jobs, or uses a network access manager that
+             * can't be moved along (see ConnectionData::canMoveToThread());
+             * a manager from ConnectionData::sharedNetworkAccessManager()
+             * is swapped for one living in the new thread.
+             *
+             * From other threads, only call the connection through
+             * invoke() or QMetaObject::invokeMethod() with a queued
+             * connection, and listen to roomsUpdated() rather than to
+             * signals of rooms and users; User::avatar() is the exception
+             * and is meant to be called from the GUI thread.
+             */
+            virtual QThread* moveToWorkerThread();
+            /**
+             * Calls f in the thread of the connection, from its event loop;
+             * can be called from any thread.
+             */
+            void invoke(std::function<void()> f);
+            /**
+             * roomsUpdated() is emitted at most once per msec milliseconds,
+             * with all the rooms updated meanwhile. 0 (the default) emits
+             * it once per processed sync.
+             */
+            Q_INVOKABLE virtual void setUpdateBatchInterval(int msec);
+            Q_INVOKABLE virtual int updateBatchInterval() const;
+
         signals:
             void connected();
             void reconnected();
@@ -69,6 +201,12 @@ namespace QMatrixClient
             void syncDone();
             void newRoom(Room* room);
             void joinedRoom(Room* room);
+            /**
+             * The rooms that received updates from syncs (or loadState()),
+             * batched; see setUpdateBatchInterval(). Unlike the signals of
+             * Room, it is safe to connect to from another thread.
+             */
+            void roomsUpdated(QStringList roomIds);
 
             void loginError(QString error);
             void connectionError(QString error);
@@ -76,6 +214,8 @@ namespace QMatrixClient
             //void jobError(BaseJob* job);
             
         protected:
+            bool event(QEvent* e) override;
+
             /**
              * Access the underlying ConnectionData class
              */
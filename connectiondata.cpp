@@ -20,8 +20,127 @@
 
 #include <QtNetwork/QNetworkAccessManager>
 
+#include "jobs/jobscheduler.h"
+#include "timerwheel.h"
+#include "mediacache.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QStandardPaths>
+#include <QtCore/QThread>
+#include <QtCore/QDebug>
+
 using namespace QMatrixClient;
 
+/** Connections per manager of the pool behind sharedNetworkAccessManager() */
+static const int ConnectionsPerSharedManager = 4;
+
+/**
+ * The pool behind sharedNetworkAccessManager(), one for the process, as
+ * connections may be deleted in another thread than the one they were
+ * created in. Managers live in the thread they were taken for and are
+ * deleted when it finishes; entries stay until no connection uses them.
+ */
+class SharedManagers
+{
+    public:
+        ~SharedManagers()
+        {
+            for( Entry* entry: entries )
+            {
+                delete entry->nam;
+                delete entry;
+            }
+        }
+
+        struct Entry
+        {
+            QNetworkAccessManager* nam;
+            QThread* thread;
+            int connections;
+        };
+
+        QMutex mutex;
+        QList<Entry*> entries;
+
+        // These are called with mutex locked
+        /** The least used manager of thread, a new one if all are busy */
+        Entry* pick(QThread* thread);
+        Entry* find(QNetworkAccessManager* nam);
+        void release(Entry* entry);
+
+    private:
+        /** Deletes the managers of the thread, called as it finishes */
+        void threadFinished(QThread* thread);
+};
+
+static SharedManagers& sharedManagers()
+{
+    static SharedManagers managers;
+    return managers;
+}
+
+SharedManagers::Entry* SharedManagers::pick(QThread* thread)
+{
+    Entry* leastUsed = nullptr;
+    for( Entry* entry: entries )
+    {
+        if( entry->thread == thread && entry->nam &&
+            (!leastUsed || entry->connections < leastUsed->connections) )
+            leastUsed = entry;
+    }
+    if( leastUsed && leastUsed->connections < ConnectionsPerSharedManager )
+        return leastUsed;
+
+    auto nam = new QNetworkAccessManager();
+    if( thread != QThread::currentThread() )
+        nam->moveToThread(thread);
+    // Called in the finishing thread, where nam lives; deleteLater()
+    // still works there, see QThread::finished()
+    QObject::connect( thread, &QThread::finished, nam,
+                      [this, thread] () { threadFinished(thread); },
+                      Qt::DirectConnection );
+    entries.append(new Entry { nam, thread, 0 });
+    return entries.last();
+}
+
+SharedManagers::Entry* SharedManagers::find(QNetworkAccessManager* nam)
+{
+    for( Entry* entry: entries )
+        if( entry->nam == nam )
+            return entry;
+    return nullptr;
+}
+
+void SharedManagers::release(Entry* entry)
+{
+    if( --entry->connections == 0 && !entry->nam )
+    {
+        entries.removeOne(entry);
+        delete entry;
+    }
+}
+
+void SharedManagers::threadFinished(QThread* thread)
+{
+    QMutexLocker locker(&mutex);
+    for( int i = entries.size() - 1; i >= 0; --i )
+    {
+        Entry* entry = entries[i];
+        if( entry->thread != thread || !entry->nam )
+            continue;
+        entry->nam->deleteLater();
+        entry->nam = nullptr;
+        if( entry->connections == 0 )
+        {
+            entries.removeAt(i);
+            delete entry;
+        }
+    }
+}
+
 class ConnectionData::Private
 {
     public:
@@ -32,18 +151,70 @@ class ConnectionData::Private
         QString token;
         QString lastEvent;
         QNetworkAccessManager* nam;
+        bool ownsNam;
+        /** The pool entry of nam if it comes from sharedNetworkAccessManager() */
+        SharedManagers::Entry* sharedEntry;
+        JobScheduler* scheduler;
+        TimerWheel* timerWheel;
+        MediaCache* mediaCache;
+
+        struct Upload
+        {
+            QUrl contentUri;
+            quint64 lastUse;
+        };
+        QHash<QByteArray, Upload> uploadedContent; // By content hash
+        QMap<quint64, QByteArray> uploadsLru; // Last use -> hash, oldest first
+        quint64 uploadUseCounter;
+        QHash<QByteArray, BaseJob*> uploadsInProgress;
+
+        void touchUpload(Upload& upload, const QByteArray& contentHash);
 };
 
-ConnectionData::ConnectionData(QUrl baseUrl)
+/** The number of uploads ConnectionData::uploadedContent() keeps */
+static const int MaxUploadedContent = 1000;
+
+void ConnectionData::Private::touchUpload(Upload& upload, const QByteArray& contentHash)
+{
+    uploadsLru.remove(upload.lastUse);
+    upload.lastUse = ++uploadUseCounter;
+    uploadsLru.insert(upload.lastUse, contentHash);
+}
+
+ConnectionData::ConnectionData(QUrl baseUrl, QNetworkAccessManager* nam)
     : d(new Private)
 {
     d->baseUrl = baseUrl;
-    d->nam = new QNetworkAccessManager();
+    d->ownsNam = !nam;
+    d->nam = nam ? nam : new QNetworkAccessManager();
+    d->sharedEntry = nullptr;
+    d->uploadUseCounter = 0;
+    if( nam )
+    {
+        SharedManagers& managers = sharedManagers();
+        QMutexLocker locker(&managers.mutex);
+        d->sharedEntry = managers.find(nam);
+        if( d->sharedEntry )
+            ++d->sharedEntry->connections;
+    }
+    d->scheduler = new JobScheduler();
+    d->timerWheel = new TimerWheel();
+    d->mediaCache = MediaCache::forDirectory(
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/media");
 }
 
 ConnectionData::~ConnectionData()
 {
-    d->nam->deleteLater();
+    if( d->ownsNam )
+        d->nam->deleteLater();
+    if( d->sharedEntry )
+    {
+        SharedManagers& managers = sharedManagers();
+        QMutexLocker locker(&managers.mutex);
+        managers.release(d->sharedEntry);
+    }
+    delete d->scheduler;
+    delete d->timerWheel;
     delete d;
 }
 
@@ -67,6 +238,54 @@ QNetworkAccessManager* ConnectionData::nam() const
     return d->nam;
 }
 
+QNetworkAccessManager* ConnectionData::sharedNetworkAccessManager()
+{
+    SharedManagers& managers = sharedManagers();
+    QMutexLocker locker(&managers.mutex);
+    return managers.pick(QThread::currentThread())->nam;
+}
+
+void ConnectionData::moveToThread(QThread* thread)
+{
+    if( d->ownsNam )
+        d->nam->moveToThread(thread);
+    else if( d->sharedEntry )
+    {
+        // Other connections keep using the manager in its thread
+        SharedManagers& managers = sharedManagers();
+        QMutexLocker locker(&managers.mutex);
+        managers.release(d->sharedEntry);
+        d->sharedEntry = managers.pick(thread);
+        ++d->sharedEntry->connections;
+        d->nam = d->sharedEntry->nam;
+    }
+    else if( d->nam->thread() != thread )
+        qWarning() << "ConnectionData: the network access manager stays in another thread,"
+                   << "requests from the connection will fail";
+    d->scheduler->moveToThread(thread);
+    d->timerWheel->moveToThread(thread);
+}
+
+bool ConnectionData::canMoveToThread() const
+{
+    return d->ownsNam || d->sharedEntry;
+}
+
+JobScheduler* ConnectionData::scheduler() const
+{
+    return d->scheduler;
+}
+
+TimerWheel* ConnectionData::timerWheel() const
+{
+    return d->timerWheel;
+}
+
+MediaCache* ConnectionData::mediaCache() const
+{
+    return d->mediaCache;
+}
+
 void ConnectionData::setToken(QString token)
 {
     d->token = token;
@@ -93,3 +312,45 @@ void ConnectionData::setLastEvent(QString identifier)
 {
     d->lastEvent = identifier;
 }
+
+QUrl ConnectionData::uploadedContentUri(const QByteArray& contentHash) const
+{
+    auto it = d->uploadedContent.find(contentHash);
+    if( it == d->uploadedContent.end() )
+        return QUrl();
+    d->touchUpload(*it, contentHash);
+    return it->contentUri;
+}
+
+void ConnectionData::addUploadedContent(const QByteArray& contentHash, QUrl contentUri)
+{
+    Private::Upload& upload = d->uploadedContent[contentHash];
+    upload.contentUri = contentUri;
+    d->touchUpload(upload, contentHash);
+    while( d->uploadedContent.size() > MaxUploadedContent )
+        d->uploadedContent.remove(d->uploadsLru.take(d->uploadsLru.firstKey()));
+}
+
+QList<QPair<QByteArray, QUrl>> ConnectionData::uploadedContent() const
+{
+    QList<QPair<QByteArray, QUrl>> uploads;
+    for( const QByteArray& contentHash: d->uploadsLru )
+        uploads.append(qMakePair(contentHash, d->uploadedContent.value(contentHash).contentUri));
+    return uploads;
+}
+
+BaseJob* ConnectionData::uploadInProgress(const QByteArray& contentHash) const
+{
+    return d->uploadsInProgress.value(contentHash);
+}
+
+void ConnectionData::addUploadInProgress(const QByteArray& contentHash, BaseJob* job)
+{
+    d->uploadsInProgress.insert(contentHash, job);
+}
+
+void ConnectionData::removeUploadInProgress(const QByteArray& contentHash, BaseJob* job)
+{
+    if( d->uploadsInProgress.value(contentHash) == job )
+        d->uploadsInProgress.remove(contentHash);
+}
@@ -20,28 +20,103 @@
 #define QMATRIXCLIENT_CONNECTIONDATA_H
 
 #include <QtCore/QUrl>
+#include <QtCore/QList>
+#include <QtCore/QPair>
 
 class QNetworkAccessManager;
+class QThread;
 
 namespace QMatrixClient
 {
+    class BaseJob;
+    class JobScheduler;
+    class TimerWheel;
+    class MediaCache;
+
     class ConnectionData
     {
         public:
-            ConnectionData(QUrl baseUrl);
+            /**
+             * If nam is given, the connection uses it instead of creating
+             * a network access manager of its own, and doesn't delete it.
+             * The manager has to live in the thread of the connection.
+             */
+            ConnectionData(QUrl baseUrl, QNetworkAccessManager* nam = nullptr);
             virtual ~ConnectionData();
+
+            /**
+             * A network access manager of the calling thread from a pool
+             * shared by the process, to pass to the constructor. Connections to the same
+             * homeserver that share a manager also share its HTTP
+             * connections and TLS sessions, instead of each account
+             * opening sockets and doing handshakes of its own.
+             *
+             * Over HTTP/1.1 QNetworkAccessManager opens at most 6
+             * connections per host, and each running sync holds one for
+             * the length of its long poll; so each manager of the pool
+             * serves at most 4 connections, leaving room for the other
+             * requests, and more managers are created as needed. Requests
+             * allow HTTP/2 (with Qt 5.10 or newer), which multiplexes
+             * them over one connection if the server supports it.
+             * Managers are deleted when their thread finishes, so
+             * connections using them must not outlive it.
+             */
+            static QNetworkAccessManager* sharedNetworkAccessManager();
+
+            /**
+             * Moves the network access manager, the scheduler and the timer
+             * wheel to thread. A manager from sharedNetworkAccessManager()
+             * stays with the other connections using it, and the connection
+             * takes a manager of the pool for thread instead; other
+             * managers given to the constructor can't be moved.
+             * Has to be called from the thread they live in, while no jobs
+             * are running.
+             */
+            void moveToThread( QThread* thread );
+            /**
+             * Whether moveToThread() takes a network access manager along;
+             * false if a manager not from sharedNetworkAccessManager()
+             * was given to the constructor.
+             */
+            bool canMoveToThread() const;
             
             //bool isConnected() const;
             QString token() const;
             QUrl baseUrl() const;
 
             QNetworkAccessManager* nam() const;
+            JobScheduler* scheduler() const;
+            /** Keeps request timeouts of all jobs of the connection */
+            TimerWheel* timerWheel() const;
+            /** Downloaded thumbnails, kept in the cache location of the application */
+            MediaCache* mediaCache() const;
             void setToken( QString token );
             void setHost( QString host );
             void setPort( int port );
 
             QString lastEvent() const;
             void setLastEvent( QString identifier );
+
+            /**
+             * Content URIs of uploaded media by the hashes of the content
+             * (see MediaUploadJob), so that the same content isn't
+             * uploaded twice. The most recently used 1000 uploads are
+             * kept. uploadedContent() returns them least recently used
+             * first, the order to add them back in.
+             */
+            QUrl uploadedContentUri( const QByteArray& contentHash ) const;
+            void addUploadedContent( const QByteArray& contentHash, QUrl contentUri );
+            QList<QPair<QByteArray, QUrl>> uploadedContent() const;
+
+            /**
+             * The job uploading the content with the hash, if any, for
+             * other uploads of the same content to wait for it instead.
+             * The job is removed with removeUploadInProgress() when it
+             * finishes.
+             */
+            BaseJob* uploadInProgress( const QByteArray& contentHash ) const;
+            void addUploadInProgress( const QByteArray& contentHash, BaseJob* job );
+            void removeUploadInProgress( const QByteArray& contentHash, BaseJob* job );
             
         private:
             class Private;
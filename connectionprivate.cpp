@@ -26,11 +26,13 @@
 #include "jobs/geteventsjob.h"
 #include "jobs/joinroomjob.h"
 #include "jobs/roommembersjob.h"
+#include "jobs/definefilterjob.h"
 #include "events/event.h"
 #include "events/roommessageevent.h"
 #include "events/roommemberevent.h"
 
 #include <QtCore/QDebug>
+#include <QtCore/QJsonDocument>
 #include <QtNetwork/QDnsLookup>
 
 using namespace QMatrixClient;
@@ -39,7 +41,20 @@ ConnectionPrivate::ConnectionPrivate(Connection* parent)
     : q(parent)
 {
     isConnected = false;
+    eventLogEnabled = false;
+    maxResidentEvents = 0;
+    syncFilter.timelineLimit = 100;
+    defineFilterJob = nullptr;
+    filterUploadFailures = 0;
+    syncLoopActive = false;
+    syncLoopPaused = false;
+    syncTimeout = 30 * 1000;
+    syncLoopJob = nullptr;
     data = nullptr;
+    roomsUpdatedTimer.setParent(this);
+    roomsUpdatedTimer.setSingleShot(true);
+    roomsUpdatedTimer.setInterval(0);
+    connect( &roomsUpdatedTimer, &QTimer::timeout, this, &ConnectionPrivate::emitRoomsUpdated );
 }
 
 ConnectionPrivate::~ConnectionPrivate()
@@ -91,8 +106,13 @@ void ConnectionPrivate::processRooms(const QList<SyncRoomData>& data)
     for( const SyncRoomData& roomData: data )
     {
         if ( Room* r = provideRoom(roomData.roomId) )
+        {
             r->updateData(roomData);
+            updatedRooms.insert(roomData.roomId);
+        }
     }
+    if( !updatedRooms.isEmpty() && !roomsUpdatedTimer.isActive() )
+        roomsUpdatedTimer.start();
 }
 
 Room* ConnectionPrivate::provideRoom(QString id)
@@ -116,6 +136,64 @@ Room* ConnectionPrivate::provideRoom(QString id)
     return room;
 }
 
+QString ConnectionPrivate::syncFilterParam()
+{
+    if( !syncFilterId.isEmpty() )
+        return syncFilterId;
+    uploadSyncFilter();
+    return QString::fromUtf8(
+        QJsonDocument(syncFilter.toJson()).toJson(QJsonDocument::Compact));
+}
+
+static const int FirstFilterRetryDelay = 30 * 1000;
+static const int MaxFilterRetryDelay = 60 * 60 * 1000;
+
+void ConnectionPrivate::uploadSyncFilter()
+{
+    if( defineFilterJob || userId.isEmpty() )
+        return;
+    if( filterUploadFailures > 0 )
+    {
+        const qint64 delay = qMin<qint64>(MaxFilterRetryDelay,
+            qint64(FirstFilterRetryDelay) << qMin(filterUploadFailures - 1, 16));
+        if( sinceFilterUploadFailed.elapsed() < delay )
+            return;
+    }
+
+    const Filter uploadedFilter = syncFilter;
+    defineFilterJob = new DefineFilterJob(data, userId, uploadedFilter);
+    connect( defineFilterJob, &DefineFilterJob::result, [=] () {
+        if( !defineFilterJob->error() )
+        {
+            // The filter may have been replaced while the job was running
+            if( syncFilter == uploadedFilter )
+                syncFilterId = defineFilterJob->filterId();
+            filterUploadFailures = 0;
+        } else {
+            qDebug() << "Can't upload the sync filter, sending it inline:"
+                     << defineFilterJob->errorString();
+            ++filterUploadFailures;
+            sinceFilterUploadFailed.start();
+        }
+        defineFilterJob = nullptr;
+    });
+    defineFilterJob->start();
+}
+
+void ConnectionPrivate::syncLoopIteration()
+{
+    if( !syncLoopActive || syncLoopPaused || syncLoopJob )
+        return;
+    syncLoopJob = q->sync(syncTimeout);
+}
+
+void ConnectionPrivate::emitRoomsUpdated()
+{
+    const QStringList roomIds = updatedRooms.values();
+    updatedRooms.clear();
+    emit q->roomsUpdated(roomIds);
+}
+
 //void ConnectionPrivate::connectDone(KJob* job)
 //{
 //    PasswordLogin* realJob = static_cast<PasswordLogin*>(job);
@@ -22,12 +22,16 @@
 class KJob;
 
 #include <QtCore/QObject>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QHash>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
 #include <QtCore/QJsonObject>
 
 #include "connection.h"
 #include "connectiondata.h"
 #include "jobs/syncjob.h"
+#include "filter.h"
 
 namespace QMatrixClient
 {
@@ -35,6 +39,8 @@ namespace QMatrixClient
     class Event;
     class State;
     class User;
+    class DefineFilterJob;
+    class MediaThumbnailJob;
 
     class ConnectionPrivate : public QObject
     {
@@ -49,17 +55,47 @@ namespace QMatrixClient
             void processRooms( const QList<SyncRoomData>& data );
             /** Finds a room with this id or creates a new one and adds it to roomMap. */
             Room* provideRoom( QString id );
+            /**
+             * The value of the filter parameter for the next sync: the id
+             * of the uploaded filter if there is one, the filter JSON
+             * otherwise (starting its upload along the way).
+             */
+            QString syncFilterParam();
+            void uploadSyncFilter();
 
             Connection* q;
             ConnectionData* data;
             QHash<QString, Room*> roomMap;
             QHash<QString, User*> userMap;
             bool isConnected;
+            bool eventLogEnabled;
+            int maxResidentEvents;
+            Filter syncFilter;
+            QString syncFilterId;
+            DefineFilterJob* defineFilterJob;
+            /**
+             * Failed filter uploads in a row; after a failure the filter
+             * is sent inline and the upload is retried with a growing delay
+             */
+            int filterUploadFailures;
+            QElapsedTimer sinceFilterUploadFailed;
+            bool syncLoopActive;
+            bool syncLoopPaused;
+            int syncTimeout;
+            SyncJob* syncLoopJob;
+            /** Thumbnail jobs in progress, by MediaCache::thumbnailKey() */
+            QHash<QString, MediaThumbnailJob*> thumbnailJobs;
+            /** Rooms updated since Connection::roomsUpdated() was last emitted */
+            QSet<QString> updatedRooms;
+            QTimer roomsUpdatedTimer;
             QString username;
             QString password;
             QString userId;
 
         public slots:
+            /** Sends the next sync of the loop unless it's stopped, paused or busy */
+            void syncLoopIteration();
+            void emitRoomsUpdated();
 //            void connectDone(KJob* job);
 //            void reconnectDone(KJob* job);
 //            void syncDone(KJob* job);
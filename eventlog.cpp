@@ -0,0 +1,440 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "eventlog.h"
+
+#include "jsonstorage.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QDataStream>
+#include <QtCore/QtEndian>
+#include <QtCore/QDebug>
+
+using namespace QMatrixClient;
+
+class EventLog::Private
+{
+    public:
+        Private(const QString& fileName)
+            : file(fileName), indexFile(fileName + ".idx")
+            , map(nullptr), mappedSize(0), loaded(false), indexedSize(0) { }
+
+        struct PendingRecord
+        {
+            QString id;
+            qint64 timestamp;
+            quint32 length;
+        };
+
+        /**
+         * Guards all of the below; other threads take it (only with
+         * tryLock(), see ensureOpen()) to close the file of this log
+         */
+        QMutex mutex;
+        QFile file;
+        QFile indexFile;
+        uchar* map;
+        qint64 mappedSize;
+        bool loaded;
+        /** The end of the last record in the index */
+        qint64 indexedSize;
+        QHash<QString, qint64> offsetsById;
+        /** In the timeline order: by origin_server_ts, then by event id */
+        QMap<QPair<qint64, QString>, qint64> offsetsByTime;
+        QByteArray pending;
+        QList<PendingRecord> pendingRecords;
+        QHash<QString, QJsonObject> pendingEvents;
+
+        /** Logs with open files, most recently used first */
+        struct OpenLogs
+        {
+            QMutex mutex;
+            QList<Private*> logs;
+        };
+        static OpenLogs& openLogs();
+        /** Opens the file, closing the least recently used log's if needed */
+        bool ensureOpen();
+        /** Closes the file and takes the log off the open logs */
+        void closeFile();
+        /** Maps the whole file, as it is now */
+        bool ensureMapped();
+        void release();
+        void index(const QString& eventId, qint64 timestamp, qint64 offset);
+        QJsonObject read(qint64 offset) const;
+        /** Empties a log written in an older format */
+        void dropOutdated();
+        void loadIndex();
+        /** Indexes the records past indexedSize, dropping a damaged tail */
+        void scanTail();
+        void appendToIndexFile(const QByteArray& entries);
+        bool contains(const QString& eventId) const;
+        void flush();
+};
+
+static const int RecordHeaderSize = sizeof(quint32);
+/** The limit of open log files in the process */
+static const int MaxOpenLogs = 32;
+
+static qint64 timestampOf(const QJsonObject& event)
+{
+    return static_cast<qint64>(event.value("origin_server_ts").toDouble());
+}
+
+static void writeIndexEntry(QDataStream& stream, const QString& eventId,
+                            qint64 timestamp, qint64 offset, quint32 length)
+{
+    stream << eventId << timestamp << offset << length;
+}
+
+EventLog::EventLog(const QString& fileName)
+    : d(new Private(fileName))
+{
+}
+
+EventLog::~EventLog()
+{
+    close();
+    delete d;
+}
+
+EventLog::Private::OpenLogs& EventLog::Private::openLogs()
+{
+    static OpenLogs logs;
+    return logs;
+}
+
+bool EventLog::Private::ensureOpen()
+{
+    // Locked after the log's own mutex, which is already held
+    OpenLogs& openLogs = Private::openLogs();
+    QMutexLocker locker(&openLogs.mutex);
+    QList<Private*>& logs = openLogs.logs;
+    if( file.isOpen() )
+    {
+        const int pos = logs.indexOf(this);
+        if( pos > 0 )
+            logs.move(pos, 0);
+        return true;
+    }
+    // Logs being used by other threads right now are skipped, and
+    // waiting for them could deadlock; their files get closed later
+    for( int i = logs.size() - 1; i >= 0 && logs.size() >= MaxOpenLogs; --i )
+    {
+        Private* log = logs.at(i);
+        if( !log->mutex.tryLock() )
+            continue;
+        log->release();
+        log->mutex.unlock();
+        logs.removeAt(i);
+    }
+    if( !file.open(QIODevice::ReadWrite) )
+    {
+        qDebug() << "EventLog: can't open" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    logs.prepend(this);
+    return true;
+}
+
+void EventLog::Private::closeFile()
+{
+    {
+        OpenLogs& openLogs = Private::openLogs();
+        QMutexLocker locker(&openLogs.mutex);
+        openLogs.logs.removeOne(this);
+    }
+    release();
+}
+
+bool EventLog::Private::ensureMapped()
+{
+    if( !ensureOpen() )
+        return false;
+    const qint64 size = file.size();
+    if( map && mappedSize == size )
+        return true;
+    if( map )
+        file.unmap(map);
+    map = nullptr;
+    mappedSize = size;
+    if( mappedSize == 0 )
+        return true;
+    map = file.map(0, mappedSize);
+    if( !map )
+    {
+        qDebug() << "EventLog: can't map" << file.fileName() << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void EventLog::Private::release()
+{
+    if( map )
+        file.unmap(map);
+    map = nullptr;
+    mappedSize = 0;
+    file.close();
+}
+
+void EventLog::Private::index(const QString& eventId, qint64 timestamp, qint64 offset)
+{
+    offsetsById.insert(eventId, offset);
+    offsetsByTime.insert(qMakePair(timestamp, eventId), offset);
+}
+
+QJsonObject EventLog::Private::read(qint64 offset) const
+{
+    const quint32 length = qFromLittleEndian<quint32>(map + offset);
+    return fromStoredJson(reinterpret_cast<const char*>(map + offset + RecordHeaderSize),
+                          int(length));
+}
+
+void EventLog::Private::dropOutdated()
+{
+    if( !ensureMapped() || mappedSize <= RecordHeaderSize )
+        return;
+    if( isStoredJson(reinterpret_cast<const char*>(map + RecordHeaderSize),
+                     int(mappedSize - RecordHeaderSize)) )
+        return;
+    qDebug() << "EventLog: discarding" << file.fileName() << "written in an older format";
+    file.unmap(map);
+    map = nullptr;
+    mappedSize = 0;
+    file.resize(0);
+    indexFile.remove();
+}
+
+void EventLog::Private::loadIndex()
+{
+    indexedSize = 0;
+    if( !indexFile.open(QIODevice::ReadOnly) )
+        return;
+
+    const qint64 logSize = file.size();
+    QDataStream stream(&indexFile);
+    stream.setVersion(QDataStream::Qt_5_0);
+    qint64 validBytes = 0;
+    while( !stream.atEnd() )
+    {
+        QString eventId;
+        qint64 timestamp, offset;
+        quint32 length;
+        stream >> eventId >> timestamp >> offset >> length;
+        // Entries go in the order of records; anything that doesn't
+        // follow on or points past the end of the log is stale
+        if( stream.status() != QDataStream::Ok || offset != indexedSize ||
+                offset + RecordHeaderSize + length > logSize )
+            break;
+        index(eventId, timestamp, offset);
+        indexedSize = offset + RecordHeaderSize + length;
+        validBytes = indexFile.pos();
+    }
+    const qint64 indexSize = indexFile.size();
+    indexFile.close();
+    if( validBytes < indexSize )
+    {
+        qDebug() << "EventLog: dropping" << indexSize - validBytes
+                 << "bytes of stale index in" << indexFile.fileName();
+        indexFile.resize(validBytes);
+    }
+}
+
+void EventLog::Private::scanTail()
+{
+    if( !ensureMapped() || indexedSize == mappedSize )
+        return;
+
+    QByteArray entries;
+    QDataStream stream(&entries, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    qint64 offset = indexedSize;
+    while( offset + RecordHeaderSize <= mappedSize )
+    {
+        const quint32 length = qFromLittleEndian<quint32>(map + offset);
+        if( offset + RecordHeaderSize + length > mappedSize )
+            break;
+        const QJsonObject event = read(offset);
+        const QString eventId = event.value("event_id").toString();
+        if( eventId.isEmpty() )
+            break;
+        index(eventId, timestampOf(event), offset);
+        writeIndexEntry(stream, eventId, timestampOf(event), offset, length);
+        offset += RecordHeaderSize + length;
+    }
+    indexedSize = offset;
+    appendToIndexFile(entries);
+    if( offset < mappedSize )
+    {
+        qDebug() << "EventLog: dropping" << mappedSize - offset
+                 << "bytes of a damaged tail in" << file.fileName();
+        file.unmap(map);
+        map = nullptr;
+        mappedSize = 0;
+        file.resize(offset);
+    }
+}
+
+void EventLog::Private::appendToIndexFile(const QByteArray& entries)
+{
+    if( entries.isEmpty() )
+        return;
+    // Only open while writing, so that a log costs one descriptor at most
+    if( !indexFile.open(QIODevice::WriteOnly | QIODevice::Append) ||
+            indexFile.write(entries) != entries.size() )
+    {
+        qDebug() << "EventLog: can't write to" << indexFile.fileName()
+                 << ":" << indexFile.errorString();
+    }
+    indexFile.close();
+}
+
+bool EventLog::open()
+{
+    QMutexLocker locker(&d->mutex);
+    if( d->loaded )
+        return true;
+    if( !d->ensureOpen() )
+        return false;
+    d->dropOutdated();
+    d->loadIndex();
+    d->scanTail();
+    d->loaded = true;
+    return true;
+}
+
+void EventLog::close()
+{
+    QMutexLocker locker(&d->mutex);
+    if( !d->loaded )
+        return;
+    d->flush();
+    d->closeFile();
+    d->loaded = false;
+    d->indexedSize = 0;
+    d->offsetsById.clear();
+    d->offsetsByTime.clear();
+}
+
+bool EventLog::isOpen() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->loaded;
+}
+
+void EventLog::append(const QJsonObject& event)
+{
+    const QString eventId = event.value("event_id").toString();
+    QMutexLocker locker(&d->mutex);
+    if( eventId.isEmpty() || d->contains(eventId) )
+        return;
+
+    const QByteArray data = toStoredJson(event);
+    uchar header[RecordHeaderSize];
+    qToLittleEndian<quint32>(data.size(), header);
+    d->pending.append(reinterpret_cast<const char*>(header), RecordHeaderSize);
+    d->pending.append(data);
+    d->pendingRecords.append({ eventId, timestampOf(event), quint32(data.size()) });
+    d->pendingEvents.insert(eventId, event);
+}
+
+void EventLog::flush()
+{
+    QMutexLocker locker(&d->mutex);
+    d->flush();
+}
+
+void EventLog::Private::flush()
+{
+    if( pending.isEmpty() || !loaded || !ensureOpen() )
+        return;
+
+    if( map )
+        file.unmap(map);
+    map = nullptr;
+    mappedSize = 0;
+    const qint64 start = file.size();
+    file.seek(start);
+    if( file.write(pending) != pending.size() || !file.flush() )
+    {
+        qDebug() << "EventLog: can't write to" << file.fileName() << ":" << file.errorString();
+        file.resize(start);
+    } else {
+        QByteArray entries;
+        QDataStream stream(&entries, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_0);
+        qint64 offset = start;
+        for( const PendingRecord& record: pendingRecords )
+        {
+            index(record.id, record.timestamp, offset);
+            writeIndexEntry(stream, record.id, record.timestamp, offset, record.length);
+            offset += RecordHeaderSize + record.length;
+        }
+        indexedSize = offset;
+        appendToIndexFile(entries);
+    }
+    pending.clear();
+    pendingRecords.clear();
+    pendingEvents.clear();
+}
+
+bool EventLog::contains(const QString& eventId) const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->contains(eventId);
+}
+
+bool EventLog::Private::contains(const QString& eventId) const
+{
+    return offsetsById.contains(eventId) || pendingEvents.contains(eventId);
+}
+
+QJsonObject EventLog::event(const QString& eventId) const
+{
+    QMutexLocker locker(&d->mutex);
+    if( d->pendingEvents.contains(eventId) )
+        return d->pendingEvents.value(eventId);
+    if( !d->offsetsById.contains(eventId) || !d->ensureMapped() || !d->map )
+        return QJsonObject();
+    return d->read(d->offsetsById.value(eventId));
+}
+
+QList<QJsonObject> EventLog::eventsBefore(qint64 timestamp, const QString& eventId,
+                                          int limit) const
+{
+    QMutexLocker locker(&d->mutex);
+    QList<QJsonObject> events;
+    if( d->offsetsByTime.isEmpty() || !d->ensureMapped() || !d->map )
+        return events;
+    auto it = d->offsetsByTime.lowerBound(qMakePair(timestamp, eventId));
+    while( it != d->offsetsByTime.begin() && events.size() < limit )
+    {
+        --it;
+        events.append(d->read(it.value()));
+    }
+    return events;
+}
+
+int EventLog::size() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->offsetsById.size() + d->pendingEvents.size();
+}
@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_EVENTLOG_H
+#define QMATRIXCLIENT_EVENTLOG_H
+
+#include <QtCore/QString>
+#include <QtCore/QList>
+#include <QtCore/QJsonObject>
+
+namespace QMatrixClient
+{
+    /**
+     * An append-only log of the events of one room, kept on disk.
+     *
+     * Each record is a 32-bit little-endian length followed by the event
+     * JSON as written by toStoredJson(); a log written in an older format
+     * is emptied when opened. The file is memory-mapped for
+     * reading. Event ids and timestamps with the offsets of their records
+     * are kept in an index file next to the log (fileName + ".idx"),
+     * appended to on every flush(), so that open() only has to decode the
+     * records the index is missing after a crash. A record cut short by
+     * a crash is dropped along with everything after it.
+     *
+     * The log file is only kept open while the log is in use: at most 32
+     * log files are open in the process, and the least recently used one
+     * is closed (and reopened on next use) when another log needs its
+     * file. Logs can be used, and deleted, from any thread; each log
+     * serializes access to itself.
+     *
+     * Appended events are buffered in memory until flush().
+     */
+    class EventLog
+    {
+        public:
+            explicit EventLog(const QString& fileName);
+            ~EventLog();
+
+            /** Creates the file if needed and loads the index */
+            bool open();
+            void close();
+            bool isOpen() const;
+
+            /**
+             * Queues the event for writing. Events without an event_id
+             * and events already in the log are ignored.
+             */
+            void append(const QJsonObject& event);
+            /** Writes queued events to the file and updates the mapping */
+            void flush();
+
+            bool contains(const QString& eventId) const;
+            QJsonObject event(const QString& eventId) const;
+            /**
+             * Returns up to limit events that come before the event with
+             * the given origin_server_ts (in ms since Epoch) and id in the
+             * timeline order, newest first. Events are ordered by
+             * origin_server_ts, and events of the same millisecond by
+             * their ids, as in findInsertionPos(). Only flushed events
+             * are looked at.
+             */
+            QList<QJsonObject> eventsBefore(qint64 timestamp, const QString& eventId,
+                                            int limit) const;
+            int size() const;
+
+        private:
+            class Private;
+            Private* d;
+    };
+}
+
+#endif // QMATRIXCLIENT_EVENTLOG_H
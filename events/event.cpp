@@ -21,9 +21,14 @@
 #include <QtCore/QJsonArray>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QDateTime>
+#include <QtCore/QHash>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QMutex>
 #include <QtCore/QDebug>
 
 #include "../logging_util.h"
+#include "../identifierpool.h"
+#include "eventpool.h"
 #include "roommessageevent.h"
 #include "roomnameevent.h"
 #include "roomaliasesevent.h"
@@ -36,20 +41,24 @@
 
 using namespace QMatrixClient;
 
-class Event::Private
+static bool lazyParsingEnabled = false;
+
+class Event::Private: public PoolAllocated
 {
     public:
         EventType type;
         QString id;
         QDateTime timestamp;
         QString roomId;
-        QString originalJson;
+        QJsonObject json;
+        bool contentParsed;
 };
 
 Event::Event(EventType type)
     : d(new Private)
 {
     d->type = type;
+    d->contentParsed = false;
 }
 
 Event::~Event()
@@ -57,6 +66,16 @@ Event::~Event()
     delete d;
 }
 
+void* Event::operator new(std::size_t size)
+{
+    return EventPool::allocate(size);
+}
+
+void Event::operator delete(void* p, std::size_t size)
+{
+    EventPool::deallocate(p, size);
+}
+
 EventType Event::type() const
 {
     return d->type;
@@ -79,75 +98,130 @@ QString Event::roomId() const
 
 QString Event::originalJson() const
 {
-    return d->originalJson;
+    return QString::fromUtf8(QJsonDocument(d->json).toJson());
+}
+
+QJsonObject Event::originalJsonObject() const
+{
+    return d->json;
+}
+
+typedef QHash<QString, EventFactory> EventFactories;
+
+/**
+ * The registry is copied on write: fromJson(), which runs for every event
+ * and on several threads at once, only loads the pointer to the current
+ * table. Tables replaced by registerEventType() are never freed, as
+ * a reader may still be looking into one; registrations are few.
+ */
+static QMutex eventFactoriesWriteLock;
+
+static QAtomicPointer<const EventFactories>& eventFactories()
+{
+    static QAtomicPointer<const EventFactories> factories(new EventFactories {
+        { "m.room.message", &makeEvent<RoomMessageEvent> },
+        { "m.room.name", &makeEvent<RoomNameEvent> },
+        { "m.room.aliases", &makeEvent<RoomAliasesEvent> },
+        { "m.room.canonical_alias", &makeEvent<RoomCanonicalAliasEvent> },
+        { "m.room.member", &makeEvent<RoomMemberEvent> },
+        { "m.room.topic", &makeEvent<RoomTopicEvent> },
+        { "m.typing", &makeEvent<TypingEvent> },
+        { "m.receipt", &makeEvent<ReceiptEvent> }
+    });
+    return factories;
 }
 
 Event* Event::fromJson(const QJsonObject& obj)
 {
-    //qDebug() << obj.value("type").toString();
-    if( obj.value("type").toString() == "m.room.message" )
-    {
-        return RoomMessageEvent::fromJson(obj);
-    }
-    if( obj.value("type").toString() == "m.room.name" )
-    {
-        return RoomNameEvent::fromJson(obj);
-    }
-    if( obj.value("type").toString() == "m.room.aliases" )
-    {
-        return RoomAliasesEvent::fromJson(obj);
-    }
-    if( obj.value("type").toString() == "m.room.canonical_alias" )
-    {
-        return RoomCanonicalAliasEvent::fromJson(obj);
-    }
-    if( obj.value("type").toString() == "m.room.member" )
-    {
-        return RoomMemberEvent::fromJson(obj);
-    }
-    if( obj.value("type").toString() == "m.room.topic" )
+    const EventFactories* factories = eventFactories().loadAcquire();
+    EventFactory factory = factories->value(obj.value("type").toString());
+    if( factory )
     {
-        return RoomTopicEvent::fromJson(obj);
-    }
-    if( obj.value("type").toString() == "m.typing" )
-    {
-        return TypingEvent::fromJson(obj);
-    }
-    if( obj.value("type").toString() == "m.receipt" )
-    {
-        return ReceiptEvent::fromJson(obj);
+        if( Event* e = factory(obj) )
+            return e;
     }
     return UnknownEvent::fromJson(obj);
 }
 
+void Event::registerEventType(const QString& type, EventFactory factory)
+{
+    QMutexLocker locker(&eventFactoriesWriteLock);
+    EventFactories* factories = new EventFactories(*eventFactories().loadAcquire());
+    if( factory )
+        factories->insert(type, factory);
+    else
+        factories->remove(type);
+    eventFactories().storeRelease(factories);
+}
+
+void Event::setLazyParsing(bool lazy)
+{
+    lazyParsingEnabled = lazy;
+}
+
+bool Event::lazyParsing()
+{
+    return lazyParsingEnabled;
+}
+
+void Event::parseContent(const QJsonObject& obj)
+{
+}
+
+void Event::ensureContentParsed() const
+{
+    if( d->contentParsed )
+        return;
+    d->contentParsed = true;
+    const_cast<Event*>(this)->parseContent(d->json);
+}
+
+/**
+ * Before Qt 5.15 a QJsonObject taken out of a document shares the data of
+ * the whole document; keeping it in the event would keep the entire sync
+ * or messages reply in memory for as long as the event lives. Wrapping
+ * a nested object into a document of its own copies just that object.
+ */
+static QJsonObject detachedCopy(const QJsonObject& obj)
+{
+#if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
+    return QJsonDocument(obj).object();
+#else
+    return obj;
+#endif
+}
+
 bool Event::parseJson(const QJsonObject& obj)
 {
-    d->originalJson = QString::fromUtf8(QJsonDocument(obj).toJson());
+    d->json = detachedCopy(obj);
     bool correct = (d->type != EventType::Unknown);
-    if ( d->type != EventType::Unknown && d->type != EventType::Typing )
+    // Events of unknown (including registered custom) types get their id
+    // and timestamp if they have them, but are not required to.
+    const bool idRequired =
+        d->type != EventType::Unknown && d->type != EventType::Typing;
+    if( obj.contains("event_id") )
+    {
+        d->id = obj.value("event_id").toString();
+    } else if( idRequired ) {
+        correct = false;
+        qDebug() << "Event: can't find event_id";
+        qDebug() << formatJson << obj;
+    }
+    if( obj.contains("origin_server_ts") )
     {
-        if( obj.contains("event_id") )
-        {
-            d->id = obj.value("event_id").toString();
-        } else {
-            correct = false;
-            qDebug() << "Event: can't find event_id";
-            qDebug() << formatJson << obj;
-        }
-        if( obj.contains("origin_server_ts") )
-        {
-            d->timestamp = QDateTime::fromMSecsSinceEpoch( 
-                static_cast<qint64>(obj.value("origin_server_ts").toDouble()), Qt::UTC );
-        } else {
-            correct = false;
-            qDebug() << "Event: can't find ts";
-            qDebug() << formatJson << obj;
-        }
+        d->timestamp = QDateTime::fromMSecsSinceEpoch( 
+            static_cast<qint64>(obj.value("origin_server_ts").toDouble()), Qt::UTC );
+    } else if( idRequired ) {
+        correct = false;
+        qDebug() << "Event: can't find ts";
+        qDebug() << formatJson << obj;
     }
     if( obj.contains("room_id") )
     {
-        d->roomId = obj.value("room_id").toString();
+        d->roomId = IdentifierPool::intern(obj.value("room_id").toString());
     }
+    if( !lazyParsingEnabled )
+        ensureContentParsed();
     return correct;
 }
 
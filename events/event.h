@@ -25,6 +25,8 @@
 #include <QtCore/QDateTime>
 #include <QtCore/QJsonObject>
 
+#include "eventpool.h"
+
 class QJsonArray;
 
 namespace QMatrixClient
@@ -35,23 +37,70 @@ namespace QMatrixClient
         RoomMember, RoomTopic, Typing, Receipt, Unknown
     };
     
+    class Event;
+
+    typedef Event* (*EventFactory)(const QJsonObject& obj);
+
+    /** An EventFactory for event classes that have a static fromJson() */
+    template <typename EventT>
+    Event* makeEvent(const QJsonObject& obj)
+    {
+        return EventT::fromJson(obj);
+    }
+
     class Event
     {
         public:
             Event(EventType type);
             virtual ~Event();
+
+            // Events are allocated from EventPool
+            static void* operator new(std::size_t size);
+            static void operator delete(void* p, std::size_t size);
             
             EventType type() const;
             QString id() const;
             QDateTime timestamp() const;
             QString roomId() const;
-            // only for debug purposes!
+            /**
+             * Renders the JSON the event was created from. This is done
+             * anew on each call, so use it only for debug purposes!
+             */
             QString originalJson() const;
+            QJsonObject originalJsonObject() const;
 
+            /**
+             * Creates an event of the class registered for its "type",
+             * or an UnknownEvent if there's none.
+             */
             static Event* fromJson(const QJsonObject& obj);
+            /**
+             * Makes fromJson() use the factory for events of the given
+             * type, replacing the one registered before, if any; this is
+             * how event classes defined outside of the library are added.
+             * Passing nullptr as the factory unregisters the type.
+             * Custom event classes should use EventType::Unknown.
+             */
+            static void registerEventType(const QString& type, EventFactory factory);
+
+            /**
+             * In the lazy parsing mode, events only decode the common
+             * fields (type, id, timestamp, room id and the sender) when
+             * created; the rest is decoded from the stored JSON object
+             * on the first call to an accessor that needs it.
+             * Off by default.
+             */
+            static void setLazyParsing(bool lazy);
+            static bool lazyParsing();
             
         protected:
             bool parseJson(const QJsonObject& obj);
+            /**
+             * Decodes the type-specific contents of the event. Accessors
+             * of such contents should call ensureContentParsed() first.
+             */
+            virtual void parseContent(const QJsonObject& obj);
+            void ensureContentParsed() const;
         
         private:
             class Private;
@@ -62,6 +111,9 @@ namespace QMatrixClient
 
     /**
      * Finds a place in the timeline where a new event/message could be inserted.
+     * Events with the same timestamp are ordered by their ids, so that
+     * the order doesn't depend on the order of arrival (EventLog relies
+     * on that).
      * @return an iterator to an item with the earliest timestamp after
      * the one of 'item'; or timeline.end(), if all events are earlier
      */
@@ -71,7 +123,8 @@ namespace QMatrixClient
     {
         return std::lower_bound (timeline.begin(), timeline.end(), item,
             [](const ItemT * a, const ItemT * b) {
-                return a->timestamp() < b->timestamp();
+                return a->timestamp() < b->timestamp() ||
+                    (a->timestamp() == b->timestamp() && a->id() < b->id());
             }
         );
     }
@@ -0,0 +1,269 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#include "eventpool.h"
+
+#include <new>
+
+#include <QtCore/QMutex>
+
+using namespace QMatrixClient;
+
+#ifndef DISABLE_EVENT_POOL
+
+// Block sizes are multiples of this; it also guarantees the alignment
+static const std::size_t Granularity = 16;
+// Objects larger than this are not pooled
+static const std::size_t MaxPooledSize = 256;
+static const std::size_t SizeClassCount = MaxPooledSize / Granularity;
+// Each size class takes memory from the heap in chunks of this size;
+// chunks are aligned to it, so a block finds its chunk by masking
+static const std::size_t ChunkSize = 64 * 1024;
+// A thread gives blocks back to the shared pool when it has more than
+// ThreadCacheLimit free blocks of one size, and takes them from there,
+// BatchSize blocks at a time
+static const int ThreadCacheLimit = 128;
+static const int BatchSize = 32;
+
+struct FreeBlock
+{
+    FreeBlock* next;
+};
+
+/** The header at the start of every chunk */
+struct Chunk
+{
+    Chunk* prev;
+    Chunk* next;
+    FreeBlock* freeList;
+    int usedBlocks;
+    bool listed; // In the list of chunks with free blocks
+};
+
+static const std::size_t ChunkHeaderSize =
+    (sizeof(Chunk) + Granularity - 1) / Granularity * Granularity;
+
+static inline Chunk* chunkOf(void* block)
+{
+    return reinterpret_cast<Chunk*>(
+        reinterpret_cast<quintptr>(block) & ~quintptr(ChunkSize - 1));
+}
+
+/** The part of the pool shared by all threads */
+class SizeClass
+{
+    public:
+        SizeClass() : chunks(nullptr) { }
+
+        /** Moves up to count blocks to the front of list; returns how many */
+        int take(std::size_t blockSize, FreeBlock*& list, int count);
+        /** Gives back count blocks from the front of list */
+        void release(FreeBlock*& list, int count);
+
+    private:
+        void link(Chunk* chunk);
+        void unlink(Chunk* chunk);
+
+        QMutex mutex;
+        Chunk* chunks; // Chunks with free blocks
+};
+
+void SizeClass::link(Chunk* chunk)
+{
+    chunk->prev = nullptr;
+    chunk->next = chunks;
+    if( chunks )
+        chunks->prev = chunk;
+    chunks = chunk;
+    chunk->listed = true;
+}
+
+void SizeClass::unlink(Chunk* chunk)
+{
+    if( chunk->prev )
+        chunk->prev->next = chunk->next;
+    else
+        chunks = chunk->next;
+    if( chunk->next )
+        chunk->next->prev = chunk->prev;
+    chunk->listed = false;
+}
+
+int SizeClass::take(std::size_t blockSize, FreeBlock*& list, int count)
+{
+    QMutexLocker locker(&mutex);
+    int taken = 0;
+    while( taken < count )
+    {
+        if( !chunks )
+        {
+            void* memory = qMallocAligned(ChunkSize, ChunkSize);
+            if( !memory )
+                break;
+            Chunk* chunk = static_cast<Chunk*>(memory);
+            chunk->freeList = nullptr;
+            chunk->usedBlocks = 0;
+            char* const start = static_cast<char*>(memory) + ChunkHeaderSize;
+            for( std::size_t offset = ChunkSize - ChunkHeaderSize; offset >= blockSize; )
+            {
+                offset -= blockSize;
+                auto block = reinterpret_cast<FreeBlock*>(start + offset);
+                block->next = chunk->freeList;
+                chunk->freeList = block;
+            }
+            link(chunk);
+        }
+        Chunk* chunk = chunks;
+        while( taken < count && chunk->freeList )
+        {
+            FreeBlock* block = chunk->freeList;
+            chunk->freeList = block->next;
+            ++chunk->usedBlocks;
+            block->next = list;
+            list = block;
+            ++taken;
+        }
+        if( !chunk->freeList )
+            unlink(chunk);
+    }
+    return taken;
+}
+
+void SizeClass::release(FreeBlock*& list, int count)
+{
+    QMutexLocker locker(&mutex);
+    for( ; count > 0 && list; --count )
+    {
+        FreeBlock* block = list;
+        list = block->next;
+        Chunk* chunk = chunkOf(block);
+        block->next = chunk->freeList;
+        chunk->freeList = block;
+        --chunk->usedBlocks;
+        if( !chunk->listed )
+            link(chunk);
+        // Keep one chunk with free blocks around to avoid churning
+        // the heap when the number of events hovers around a chunk
+        if( chunk->usedBlocks == 0 && (chunk->prev || chunk->next) )
+        {
+            unlink(chunk);
+            qFreeAligned(chunk);
+        }
+    }
+}
+
+static SizeClass sizeClasses[SizeClassCount];
+
+/**
+ * Free blocks owned by the current thread. It's trivially destructible,
+ * so that it stays usable for objects freed after the thread's cleanup
+ * (see ThreadCacheOwner), which sets the flushed flag.
+ */
+struct ThreadCache
+{
+    FreeBlock* lists[SizeClassCount];
+    int counts[SizeClassCount];
+    bool flushed;
+};
+
+static thread_local ThreadCache threadCache;
+
+/** Gives the blocks of the thread's cache back when the thread ends */
+struct ThreadCacheOwner
+{
+    void ensureRegistered() { }
+
+    ~ThreadCacheOwner()
+    {
+        for( std::size_t i = 0; i < SizeClassCount; ++i )
+        {
+            sizeClasses[i].release(threadCache.lists[i], threadCache.counts[i]);
+            threadCache.counts[i] = 0;
+        }
+        threadCache.flushed = true;
+    }
+};
+
+static thread_local ThreadCacheOwner threadCacheOwner;
+
+void* EventPool::allocate(std::size_t size)
+{
+    if( size == 0 || size > MaxPooledSize )
+        return ::operator new(size);
+
+    const std::size_t index = (size - 1) / Granularity;
+    ThreadCache& cache = threadCache;
+    FreeBlock*& list = cache.lists[index];
+    if( !list )
+    {
+        int count = BatchSize;
+        if( cache.flushed )
+            count = 1; // Don't keep blocks that no one would give back
+        else
+            threadCacheOwner.ensureRegistered();
+        const int taken =
+            sizeClasses[index].take((index + 1) * Granularity, list, count);
+        if( taken == 0 )
+            throw std::bad_alloc();
+        cache.counts[index] += taken;
+    }
+    FreeBlock* block = list;
+    list = block->next;
+    --cache.counts[index];
+    return block;
+}
+
+void EventPool::deallocate(void* p, std::size_t size)
+{
+    if( !p )
+        return;
+    if( size == 0 || size > MaxPooledSize )
+    {
+        ::operator delete(p);
+        return;
+    }
+
+    const std::size_t index = (size - 1) / Granularity;
+    ThreadCache& cache = threadCache;
+    auto block = static_cast<FreeBlock*>(p);
+    block->next = cache.lists[index];
+    cache.lists[index] = block;
+    if( cache.flushed )
+    {
+        sizeClasses[index].release(cache.lists[index], 1);
+        return;
+    }
+    if( ++cache.counts[index] > ThreadCacheLimit )
+    {
+        sizeClasses[index].release(cache.lists[index], BatchSize);
+        cache.counts[index] -= BatchSize;
+    }
+}
+
+#else // DISABLE_EVENT_POOL
+
+void* EventPool::allocate(std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void EventPool::deallocate(void* p, std::size_t)
+{
+    ::operator delete(p);
+}
+
+#endif // DISABLE_EVENT_POOL
@@ -0,0 +1,63 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_EVENTPOOL_H
+#define QMATRIXCLIENT_EVENTPOOL_H
+
+#include <cstddef>
+
+namespace QMatrixClient
+{
+    /**
+     * A pool allocator for Event objects, their Private parts and other
+     * small objects created in large numbers when decoding events.
+     * Memory is taken from the heap in big chunks split into blocks of
+     * a few fixed sizes; freed blocks go back to the pool and are reused
+     * by later events. Each thread keeps a small cache of free blocks,
+     * so allocating and releasing an event is a couple of pointer
+     * operations without locking; the shared pool is only visited for
+     * batches of blocks. A chunk whose blocks are all free again is
+     * returned to the heap, unless it's the last one with free blocks
+     * of its size.
+     *
+     * If the library is built with DISABLE_EVENT_POOL (EVENT_POOL=OFF in
+     * CMake), this simply forwards to the global operator new/delete.
+     */
+    class EventPool
+    {
+        public:
+            static void* allocate(std::size_t size);
+            static void deallocate(void* p, std::size_t size);
+    };
+
+    /** Makes the objects of a derived class come from EventPool */
+    class PoolAllocated
+    {
+        public:
+            static void* operator new(std::size_t size)
+            {
+                return EventPool::allocate(size);
+            }
+            static void operator delete(void* p, std::size_t size)
+            {
+                EventPool::deallocate(p, size);
+            }
+    };
+}
+
+#endif // QMATRIXCLIENT_EVENTPOOL_H
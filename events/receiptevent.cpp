@@ -39,6 +39,8 @@ Example of a Receipt Event:
 #include <QtCore/QJsonArray>
 #include <QtCore/QDebug>
 
+#include "../identifierpool.h"
+
 using namespace QMatrixClient;
 
 Receipt::Receipt(QString event, QString user, QDateTime time)
@@ -48,7 +50,7 @@ Receipt::Receipt(QString event, QString user, QDateTime time)
 {
 }
 
-class ReceiptEvent::Private
+class ReceiptEvent::Private: public PoolAllocated
 {
     public:
         QHash<QString, QList<Receipt>> eventToReceipts;
@@ -67,11 +69,13 @@ ReceiptEvent::~ReceiptEvent()
 
 QList<Receipt> ReceiptEvent::receiptsForEvent(QString eventId) const
 {
+    ensureContentParsed();
     return d->eventToReceipts.value(eventId);
 }
 
 QStringList ReceiptEvent::events() const
 {
+    ensureContentParsed();
     return d->eventToReceipts.keys();
 }
 
@@ -79,6 +83,11 @@ ReceiptEvent* ReceiptEvent::fromJson(const QJsonObject& obj)
 {
     ReceiptEvent* e = new ReceiptEvent();
     e->parseJson(obj);
+    return e;
+}
+
+void ReceiptEvent::parseContent(const QJsonObject& obj)
+{
     const QJsonObject contents = obj.value("content").toObject();
     for( const QString& eventId: contents.keys() )
     {
@@ -88,10 +97,9 @@ ReceiptEvent* ReceiptEvent::fromJson(const QJsonObject& obj)
         {
             QJsonObject user = reads.value(userId).toObject();
             QDateTime time = QDateTime::fromMSecsSinceEpoch( (quint64) user.value("ts").toDouble(), Qt::UTC );
-            Receipt receipt(eventId, userId, time);
+            Receipt receipt(eventId, IdentifierPool::intern(userId), time);
             receipts.append(receipt);
         }
-        e->d->eventToReceipts.insert(eventId, receipts);
+        d->eventToReceipts.insert(eventId, receipts);
     }
-    return e;
 }
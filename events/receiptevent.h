@@ -47,6 +47,9 @@ namespace QMatrixClient
 
             static ReceiptEvent* fromJson(const QJsonObject& obj);
 
+        protected:
+            void parseContent(const QJsonObject& obj) override;
+
         private:
             class Private;
             Private* d;
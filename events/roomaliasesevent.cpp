@@ -40,7 +40,7 @@
 
 using namespace QMatrixClient;
 
-class RoomAliasesEvent::Private
+class RoomAliasesEvent::Private: public PoolAllocated
 {
     public:
         QStringList aliases;
@@ -59,6 +59,7 @@ RoomAliasesEvent::~RoomAliasesEvent()
 
 QStringList RoomAliasesEvent::aliases() const
 {
+    ensureContentParsed();
     return d->aliases;
 }
 
@@ -66,12 +67,16 @@ RoomAliasesEvent* RoomAliasesEvent::fromJson(const QJsonObject& obj)
 {
     RoomAliasesEvent* e = new RoomAliasesEvent();
     e->parseJson(obj);
+    return e;
+}
+
+void RoomAliasesEvent::parseContent(const QJsonObject& obj)
+{
     const QJsonObject contents = obj.value("content").toObject();
     const QJsonArray aliases = contents.value("aliases").toArray();
     for( const QJsonValue& alias : aliases )
     {
-        e->d->aliases << alias.toString();
+        d->aliases << alias.toString();
     }
-    qDebug() << "RoomAliasesEvent:" << e->d->aliases;
-    return e;
+    qDebug() << "RoomAliasesEvent:" << d->aliases;
 }
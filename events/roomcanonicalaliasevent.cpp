@@ -20,7 +20,7 @@
 
 using namespace QMatrixClient;
 
-class RoomCanonicalAliasEvent::Private
+class RoomCanonicalAliasEvent::Private: public PoolAllocated
 {
     public:
         QString alias;
@@ -39,6 +39,7 @@ RoomCanonicalAliasEvent::~RoomCanonicalAliasEvent()
 
 QString RoomCanonicalAliasEvent::alias()
 {
+    ensureContentParsed();
     return d->alias;
 }
 
@@ -46,8 +47,12 @@ RoomCanonicalAliasEvent* RoomCanonicalAliasEvent::fromJson(const QJsonObject& ob
 {
     RoomCanonicalAliasEvent* e = new RoomCanonicalAliasEvent();
     e->parseJson(obj);
-    const QJsonObject contents = obj.value("content").toObject();
-    e->d->alias = contents.value("alias").toString();
     return e;
 }
 
+void RoomCanonicalAliasEvent::parseContent(const QJsonObject& obj)
+{
+    const QJsonObject contents = obj.value("content").toObject();
+    d->alias = contents.value("alias").toString();
+}
+
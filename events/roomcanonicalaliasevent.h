@@ -33,6 +33,9 @@ namespace QMatrixClient
 
             static RoomCanonicalAliasEvent* fromJson(const QJsonObject& obj);
 
+        protected:
+            void parseContent(const QJsonObject& obj) override;
+
         private:
             class Private;
             Private* d;
@@ -21,9 +21,11 @@
 #include <QtCore/QDebug>
 #include <QtCore/QUrl>
 
+#include "../identifierpool.h"
+
 using namespace QMatrixClient;
 
-class RoomMemberEvent::Private
+class RoomMemberEvent::Private: public PoolAllocated
 {
     public:
         MembershipType membership;
@@ -45,6 +47,7 @@ RoomMemberEvent::~RoomMemberEvent()
 
 MembershipType RoomMemberEvent::membership() const
 {
+    ensureContentParsed();
     return d->membership;
 }
 
@@ -55,11 +58,13 @@ QString RoomMemberEvent::userId() const
 
 QString RoomMemberEvent::displayName() const
 {
+    ensureContentParsed();
     return d->displayname;
 }
 
 QUrl RoomMemberEvent::avatarUrl() const
 {
+    ensureContentParsed();
     return d->avatarUrl;
 }
 
@@ -67,22 +72,26 @@ RoomMemberEvent* RoomMemberEvent::fromJson(const QJsonObject& obj)
 {
     RoomMemberEvent* e = new RoomMemberEvent();
     e->parseJson(obj);
-    e->d->userId = obj.value("state_key").toString();
+    e->d->userId = IdentifierPool::intern(obj.value("state_key").toString());
+    return e;
+}
+
+void RoomMemberEvent::parseContent(const QJsonObject& obj)
+{
     QJsonObject content = obj.value("content").toObject();
-    e->d->displayname = content.value("displayname").toString();
+    d->displayname = content.value("displayname").toString();
     QString membershipString = content.value("membership").toString();
     if( membershipString == "invite" )
-        e->d->membership = MembershipType::Invite;
+        d->membership = MembershipType::Invite;
     else if( membershipString == "join" )
-        e->d->membership = MembershipType::Join;
+        d->membership = MembershipType::Join;
     else if( membershipString == "knock" )
-        e->d->membership = MembershipType::Knock;
+        d->membership = MembershipType::Knock;
     else if( membershipString == "leave" )
-        e->d->membership = MembershipType::Leave;
+        d->membership = MembershipType::Leave;
     else if( membershipString == "ban" )
-        e->d->membership = MembershipType::Ban;
+        d->membership = MembershipType::Ban;
     else
         qDebug() << "Unknown MembershipType: " << membershipString;
-    e->d->avatarUrl = QUrl(content.value("avatar_url").toString());
-    return e;
+    d->avatarUrl = QUrl(content.value("avatar_url").toString());
 }
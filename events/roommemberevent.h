@@ -41,6 +41,9 @@ namespace QMatrixClient
 
             static RoomMemberEvent* fromJson(const QJsonObject& obj);
 
+        protected:
+            void parseContent(const QJsonObject& obj) override;
+
         private:
             class Private;
             Private* d;
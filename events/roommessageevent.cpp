@@ -22,9 +22,11 @@
 #include <QtCore/QDateTime>
 #include <QtCore/QDebug>
 
+#include "../identifierpool.h"
+
 using namespace QMatrixClient;
 
-class RoomMessageEvent::Private
+class RoomMessageEvent::Private: public PoolAllocated
 {
     public:
         Private() {}
@@ -54,11 +56,13 @@ QString RoomMessageEvent::userId() const
 
 MessageEventType RoomMessageEvent::msgtype() const
 {
+    ensureContentParsed();
     return d->msgtype;
 }
 
 QString RoomMessageEvent::body() const
 {
+    ensureContentParsed();
     return d->content->body;
 }
 
@@ -69,7 +73,8 @@ QDateTime RoomMessageEvent::hsob_ts() const
 
 MessageEventContent* RoomMessageEvent::content() const
 {
-        return d->content;
+    ensureContentParsed();
+    return d->content;
 }
 
 RoomMessageEvent* RoomMessageEvent::fromJson(const QJsonObject& obj)
@@ -78,10 +83,15 @@ RoomMessageEvent* RoomMessageEvent::fromJson(const QJsonObject& obj)
     e->parseJson(obj);
     if( obj.contains("sender") )
     {
-        e->d->userId = obj.value("sender").toString();
+        e->d->userId = IdentifierPool::intern(obj.value("sender").toString());
     } else {
         qDebug() << "RoomMessageEvent: user_id not found";
     }
+    return e;
+}
+
+void RoomMessageEvent::parseContent(const QJsonObject& obj)
+{
     if( obj.contains("content") )
     {
         QJsonObject content = obj.value("content").toObject();
@@ -89,22 +99,22 @@ RoomMessageEvent* RoomMessageEvent::fromJson(const QJsonObject& obj)
 
         if( msgtype == "m.text" )
         {
-            e->d->msgtype = MessageEventType::Text;
-            e->d->content = new MessageEventContent();
+            d->msgtype = MessageEventType::Text;
+            d->content = new MessageEventContent();
         }
         else if( msgtype == "m.emote" )
         {
-            e->d->msgtype = MessageEventType::Emote;
-            e->d->content = new MessageEventContent();
+            d->msgtype = MessageEventType::Emote;
+            d->content = new MessageEventContent();
         }
         else if( msgtype == "m.notice" )
         {
-            e->d->msgtype = MessageEventType::Notice;
-            e->d->content = new MessageEventContent();
+            d->msgtype = MessageEventType::Notice;
+            d->content = new MessageEventContent();
         }
         else if( msgtype == "m.image" )
         {
-            e->d->msgtype = MessageEventType::Image;
+            d->msgtype = MessageEventType::Image;
             ImageEventContent* c = new ImageEventContent;
             c->url = QUrl(content.value("url").toString());
             QJsonObject info = content.value("info").toObject();
@@ -112,22 +122,22 @@ RoomMessageEvent* RoomMessageEvent::fromJson(const QJsonObject& obj)
             c->width = info.value("w").toInt();
             c->size = info.value("size").toInt();
             c->mimetype = info.value("mimetype").toString();
-            e->d->content = c;
+            d->content = c;
         }
         else if( msgtype == "m.file" )
         {
-            e->d->msgtype = MessageEventType::File;
+            d->msgtype = MessageEventType::File;
             FileEventContent* c = new FileEventContent;
             c->filename = content.value("filename").toString();
             c->url = QUrl(content.value("url").toString());
             QJsonObject info = content.value("info").toObject();
             c->size = info.value("size").toInt();
             c->mimetype = info.value("mimetype").toString();
-            e->d->content = c;
+            d->content = c;
         }
         else if( msgtype == "m.location" )
         {
-            e->d->msgtype = MessageEventType::Location;
+            d->msgtype = MessageEventType::Location;
             LocationEventContent* c = new LocationEventContent;
             c->geoUri = content.value("geo_uri").toString();
             c->thumbnailUrl = QUrl(content.value("thumbnail_url").toString());
@@ -136,11 +146,11 @@ RoomMessageEvent* RoomMessageEvent::fromJson(const QJsonObject& obj)
             c->thumbnailWidth = info.value("w").toInt();
             c->thumbnailSize = info.value("size").toInt();
             c->thumbnailMimetype = info.value("mimetype").toString();
-            e->d->content = c;
+            d->content = c;
         }
         else if( msgtype == "m.video" )
         {
-            e->d->msgtype = MessageEventType::Video;
+            d->msgtype = MessageEventType::Video;
             VideoEventContent* c = new VideoEventContent;
             c->url = QUrl(content.value("url").toString());
             QJsonObject info = content.value("info").toObject();
@@ -154,30 +164,30 @@ RoomMessageEvent* RoomMessageEvent::fromJson(const QJsonObject& obj)
             c->thumbnailWidth = thumbnailInfo.value("w").toInt();
             c->thumbnailSize = thumbnailInfo.value("size").toInt();
             c->thumbnailMimetype = thumbnailInfo.value("mimetype").toString();
-            e->d->content = c;
+            d->content = c;
         }
         else if( msgtype == "m.audio" )
         {
-            e->d->msgtype = MessageEventType::Audio;
+            d->msgtype = MessageEventType::Audio;
             AudioEventContent* c = new AudioEventContent;
             c->url = QUrl(content.value("url").toString());
             QJsonObject info = content.value("info").toObject();
             c->duration = info.value("duration").toInt();
             c->mimetype = info.value("mimetype").toString();
             c->size = info.value("size").toInt();
-            e->d->content = c;
+            d->content = c;
         }
         else
         {
             qDebug() << "RoomMessageEvent: unknown msgtype: " << msgtype;
             qDebug() << obj;
-            e->d->msgtype = MessageEventType::Unkown;
-            e->d->content = new MessageEventContent;
+            d->msgtype = MessageEventType::Unkown;
+            d->content = new MessageEventContent;
         }
 
         if( content.contains("body") )
         {
-            e->d->content->body = content.value("body").toString();
+            d->content->body = content.value("body").toString();
         } else {
             qDebug() << "RoomMessageEvent: body not found";
         }
@@ -186,5 +196,4 @@ RoomMessageEvent* RoomMessageEvent::fromJson(const QJsonObject& obj)
 //             qDebug() << "RoomMessageEvent: hsoc_ts not found";
 //         }
     }
-    return e;
 }
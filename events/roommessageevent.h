@@ -22,6 +22,7 @@
 #include <QtCore/QUrl>
 
 #include "event.h"
+#include "eventpool.h"
 
 namespace QMatrixClient
 {
@@ -30,7 +31,7 @@ namespace QMatrixClient
         Text, Emote, Notice, Image, File, Location, Video, Audio, Unkown
     };
 
-    class MessageEventContent
+    class MessageEventContent: public PoolAllocated
     {
         public:
             virtual ~MessageEventContent() {}
@@ -53,6 +54,9 @@ namespace QMatrixClient
         
             static RoomMessageEvent* fromJson( const QJsonObject& obj );
             
+        protected:
+            void parseContent(const QJsonObject& obj) override;
+
         private:
             class Private;
             Private* d;
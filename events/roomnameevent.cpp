@@ -20,7 +20,7 @@
 
 using namespace QMatrixClient;
 
-class RoomNameEvent::Private
+class RoomNameEvent::Private: public PoolAllocated
 {
 public:
     QString name;
@@ -39,6 +39,7 @@ RoomNameEvent::~RoomNameEvent()
 
 QString RoomNameEvent::name() const
 {
+    ensureContentParsed();
     return d->name;
 }
 
@@ -46,7 +47,11 @@ RoomNameEvent* RoomNameEvent::fromJson(const QJsonObject& obj)
 {
     RoomNameEvent* e = new RoomNameEvent();
     e->parseJson(obj);
-    const QJsonObject contents = obj.value("content").toObject();
-    e->d->name = contents.value("name").toString();
     return e;
 }
+
+void RoomNameEvent::parseContent(const QJsonObject& obj)
+{
+    const QJsonObject contents = obj.value("content").toObject();
+    d->name = contents.value("name").toString();
+}
@@ -34,6 +34,9 @@ public:
 
     static RoomNameEvent* fromJson(const QJsonObject& obj);
 
+protected:
+    void parseContent(const QJsonObject& obj) override;
+
 private:
     class Private;
     Private *d;
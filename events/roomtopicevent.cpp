@@ -20,7 +20,7 @@
 
 using namespace QMatrixClient;
 
-class RoomTopicEvent::Private
+class RoomTopicEvent::Private: public PoolAllocated
 {
     public:
         QString topic;
@@ -39,6 +39,7 @@ RoomTopicEvent::~RoomTopicEvent()
 
 QString RoomTopicEvent::topic() const
 {
+    ensureContentParsed();
     return d->topic;
 }
 
@@ -46,6 +47,10 @@ RoomTopicEvent* RoomTopicEvent::fromJson(const QJsonObject& obj)
 {
     RoomTopicEvent* e = new RoomTopicEvent();
     e->parseJson(obj);
-    e->d->topic = obj.value("content").toObject().value("topic").toString();
     return e;
 }
+
+void RoomTopicEvent::parseContent(const QJsonObject& obj)
+{
+    d->topic = obj.value("content").toObject().value("topic").toString();
+}
@@ -35,6 +35,9 @@ namespace QMatrixClient
 
             static RoomTopicEvent* fromJson(const QJsonObject& obj);
 
+        protected:
+            void parseContent(const QJsonObject& obj) override;
+
         private:
             class Private;
             Private* d;
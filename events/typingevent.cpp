@@ -21,9 +21,11 @@
 #include <QtCore/QJsonArray>
 #include <QtCore/QDebug>
 
+#include "../identifierpool.h"
+
 using namespace QMatrixClient;
 
-class TypingEvent::Private
+class TypingEvent::Private: public PoolAllocated
 {
     public:
         QStringList users;
@@ -42,6 +44,7 @@ TypingEvent::~TypingEvent()
 
 QStringList TypingEvent::users()
 {
+    ensureContentParsed();
     return d->users;
 }
 
@@ -49,11 +52,15 @@ TypingEvent* TypingEvent::fromJson(const QJsonObject& obj)
 {
     TypingEvent* e = new TypingEvent();
     e->parseJson(obj);
+    return e;
+}
+
+void TypingEvent::parseContent(const QJsonObject& obj)
+{
     QJsonArray array = obj.value("content").toObject().value("user_ids").toArray();
     for( const QJsonValue& user: array )
     {
-        e->d->users << user.toString();
+        d->users << IdentifierPool::intern(user.toString());
     }
-    qDebug() << "Typing:" << e->d->users;
-    return e;
+    qDebug() << "Typing:" << d->users;
 }
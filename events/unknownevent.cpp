@@ -18,18 +18,16 @@
 
 #include "unknownevent.h"
 
-#include <QtCore/QJsonDocument>
 #include <QtCore/QDebug>
 
-#include "../logging_util.h"
+#include "../identifierpool.h"
 
 using namespace QMatrixClient;
 
-class UnknownEvent::Private
+class UnknownEvent::Private: public PoolAllocated
 {
     public:
         QString type;
-        QString content;
 };
 
 UnknownEvent::UnknownEvent()
@@ -50,16 +48,14 @@ QString UnknownEvent::typeString() const
 
 QString UnknownEvent::content() const
 {
-    return d->content;
+    return originalJson();
 }
 
 UnknownEvent* UnknownEvent::fromJson(const QJsonObject& obj)
 {
     UnknownEvent* e = new UnknownEvent();
     e->parseJson(obj);
-    e->d->type = obj.value("type").toString();
-    e->d->content = QString::fromUtf8(QJsonDocument(obj).toJson());
-    qDebug() << "UnknownEvent, JSON follows:";
-    qDebug() << formatJson << obj;
+    e->d->type = IdentifierPool::intern(obj.value("type").toString());
+    qDebug() << "UnknownEvent:" << e->d->type;
     return e;
 }
@@ -0,0 +1,74 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "filter.h"
+
+#include <QtCore/QJsonArray>
+
+using namespace QMatrixClient;
+
+Filter::Filter()
+    : timelineLimit(-1)
+    , lazyLoadMembers(false)
+{
+}
+
+static void insertList(QJsonObject& json, const QString& key, const QStringList& list)
+{
+    if( !list.isEmpty() )
+        json.insert(key, QJsonArray::fromStringList(list));
+}
+
+QJsonObject Filter::toJson() const
+{
+    QJsonObject timeline;
+    if( timelineLimit >= 0 )
+        timeline.insert("limit", timelineLimit);
+    insertList(timeline, "types", types);
+    insertList(timeline, "not_types", notTypes);
+
+    QJsonObject state;
+    if( lazyLoadMembers )
+    {
+        timeline.insert("lazy_load_members", true);
+        state.insert("lazy_load_members", true);
+    }
+
+    QJsonObject room;
+    insertList(room, "rooms", rooms);
+    insertList(room, "not_rooms", notRooms);
+    if( !timeline.isEmpty() )
+        room.insert("timeline", timeline);
+    if( !state.isEmpty() )
+        room.insert("state", state);
+
+    QJsonObject json;
+    insertList(json, "event_fields", eventFields);
+    if( !room.isEmpty() )
+        json.insert("room", room);
+    return json;
+}
+
+bool Filter::operator==(const Filter& other) const
+{
+    return timelineLimit == other.timelineLimit &&
+           types == other.types && notTypes == other.notTypes &&
+           rooms == other.rooms && notRooms == other.notRooms &&
+           lazyLoadMembers == other.lazyLoadMembers &&
+           eventFields == other.eventFields;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_FILTER_H
+#define QMATRIXCLIENT_FILTER_H
+
+#include <QtCore/QStringList>
+#include <QtCore/QJsonObject>
+
+namespace QMatrixClient
+{
+    /**
+     * A server-side filter for /sync, see section 6.2 of the CS spec.
+     * Empty lists and a negative timeline limit are left out, leaving
+     * the server defaults in place.
+     */
+    class Filter
+    {
+        public:
+            Filter();
+
+            /** The maximum number of timeline events per room in a sync */
+            int timelineLimit;
+            /** Event types to include in timelines (all if empty) */
+            QStringList types;
+            /** Event types to exclude from timelines */
+            QStringList notTypes;
+            /** Rooms to include (all if empty) */
+            QStringList rooms;
+            /** Rooms to exclude */
+            QStringList notRooms;
+            /** Only send member events for senders of the timeline events */
+            bool lazyLoadMembers;
+            /**
+             * Fields of events to send, as dot-separated paths
+             * (e.g. "content.body"); whole events if empty. Note that
+             * the library needs "type", "event_id", "origin_server_ts"
+             * and "sender" to process events properly.
+             */
+            QStringList eventFields;
+
+            QJsonObject toJson() const;
+
+            bool operator==(const Filter& other) const;
+            bool operator!=(const Filter& other) const { return !(*this == other); }
+    };
+}
+
+#endif // QMATRIXCLIENT_FILTER_H
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "identifierpool.h"
+
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+
+using namespace QMatrixClient;
+
+/**
+ * The pool is split into shards with a lock each, picked by the hash of
+ * the identifier, so that threads interning different identifiers
+ * rarely wait for each other.
+ */
+static const int ShardCount = 16;
+/**
+ * Each thread also keeps the identifiers it has interned lately; the
+ * same few room ids, senders and types repeat all over a sync response,
+ * so most lookups end there without taking any lock.
+ */
+static const int MaxCachedPerThread = 4096;
+
+struct PoolShard
+{
+    QMutex mutex;
+    QSet<QString> ids;
+};
+
+static PoolShard shards[ShardCount];
+
+QString IdentifierPool::intern(const QString& id)
+{
+    if( id.isEmpty() )
+        return id;
+
+    static thread_local QSet<QString> cache;
+    auto cached = cache.constFind(id);
+    if( cached != cache.constEnd() )
+        return *cached;
+
+    PoolShard& shard = shards[qHash(id) % ShardCount];
+    QString pooled;
+    {
+        QMutexLocker locker(&shard.mutex);
+        // Leaves the id in place if it's already there
+        pooled = *shard.ids.insert(id);
+    }
+    if( cache.size() >= MaxCachedPerThread )
+        cache.clear();
+    cache.insert(pooled);
+    return pooled;
+}
+
+int IdentifierPool::size()
+{
+    int size = 0;
+    for( PoolShard& shard: shards )
+    {
+        QMutexLocker locker(&shard.mutex);
+        size += shard.ids.size();
+    }
+    return size;
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_IDENTIFIERPOOL_H
+#define QMATRIXCLIENT_IDENTIFIERPOOL_H
+
+#include <QtCore/QString>
+
+namespace QMatrixClient
+{
+    /**
+     * Keeps a single shared copy of each distinct identifier (room ids,
+     * user ids, event types) seen by the library. Events use it so that
+     * the same sender or room id repeated across thousands of events
+     * takes memory only once; comparing two interned strings also
+     * short-circuits on the shared data.
+     * Identifiers are never removed from the pool.
+     */
+    class IdentifierPool
+    {
+        public:
+            /**
+             * Returns the pooled copy of the identifier, adding it to
+             * the pool if it's not there yet. Thread-safe.
+             */
+            static QString intern(const QString& id);
+
+            static int size();
+    };
+}
+
+#endif // QMATRIXCLIENT_IDENTIFIERPOOL_H
@@ -21,24 +21,194 @@
 #include <QtNetwork/QNetworkAccessManager>
 #include <QtNetwork/QNetworkReply>
 #include <QtNetwork/QNetworkRequest>
-#include <QtCore/QTimer>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QEvent>
+#include <QtCore/QPointer>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QThreadPool>
+#include <QtCore/QHash>
+#include <QtCore/QDebug>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+#include <QtCore/QRandomGenerator>
+#else
+#include <QtCore/QDateTime>
+#include <QtCore/QThread>
+#endif
 
 #include "../connectiondata.h"
+#include "jobscheduler.h"
+#include "../timerwheel.h"
 
 using namespace QMatrixClient;
 
 class BaseJob::Private
 {
     public:
+        class Delivery;
+        class Runner;
+
         Private(ConnectionData* c, JobHttpType t, bool nt)
-            : connection(c), reply(nullptr), type(t), needsToken(nt) {}
+            : connection(c), reply(nullptr), type(t), needsToken(nt)
+            , parseInBackground(false), maxAttempts(3), attempt(0)
+            , priority(JobPriority::Send), requestTimeout(DefaultRequestTimeout)
+            , wheel(c->timerWheel()), timeoutId(0), retryId(0), requestData(nullptr) {}
         
         ConnectionData* connection;
         QNetworkReply* reply;
         JobHttpType type;
         bool needsToken;
+        bool parseInBackground;
+        int maxAttempts;
+        int attempt;
+        JobPriority priority;
+        int requestTimeout;
+        // The wheel is owned by ConnectionData, which may go away first
+        QPointer<TimerWheel> wheel;
+        TimerWheel::TimerId timeoutId;
+        TimerWheel::TimerId retryId;
+        QHash<QByteArray, QByteArray> requestHeaders;
+        QIODevice* requestData;
+
+        /** Shared with the worker thread while it's decoding */
+        QSharedPointer<Decoder> decoder;
+        /** Stops the timers when the job finishes */
+        QMetaObject::Connection stopTimersOnFinish;
+
+        /** Makes the current decoder, if any, drop its results */
+        void cancelDecoder();
+        /** Only these can be repeated after a server or network error */
+        bool isIdempotent() const { return type != JobHttpType::PostJob; }
+        bool canRetry() const { return attempt < maxAttempts; }
+        /** The delay before the next attempt, growing with each attempt */
+        int backoffDelay() const;
+        /** Stops listening to the current reply and aborts it */
+        void dropReply(BaseJob* job);
+        void cancelTimer(TimerWheel::TimerId& id);
+};
+
+static const int FirstRetryDelay = 1000;
+static const int MaxRetryDelay = 60 * 1000;
+
+int BaseJob::Private::backoffDelay() const
+{
+    const int delay = qMin(MaxRetryDelay, FirstRetryDelay << qMin(attempt - 1, 16));
+    // Spread retries of jobs that failed together over time, including
+    // the jobs of other threads and processes
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    return delay / 2 + QRandomGenerator::global()->bounded(delay / 2 + 1);
+#else
+    // qrand() has an unseeded state per thread
+    static thread_local bool seeded = false;
+    if( !seeded )
+    {
+        qsrand(uint(QDateTime::currentMSecsSinceEpoch()) ^
+               uint(quintptr(QThread::currentThreadId())));
+        seeded = true;
+    }
+    return delay / 2 + qrand() % (delay / 2 + 1);
+#endif
+}
+
+void BaseJob::Private::cancelTimer(TimerWheel::TimerId& id)
+{
+    if( id && wheel )
+        wheel->cancel(id);
+    id = 0;
+}
+
+void BaseJob::Private::dropReply(BaseJob* job)
+{
+    cancelTimer(timeoutId);
+    if( !reply )
+        return;
+    reply->disconnect(job);
+    if( reply->isRunning() )
+        reply->abort();
+}
+
+void BaseJob::Private::cancelDecoder()
+{
+    if( decoder )
+        decoder->cancel();
+    decoder.reset();
+}
+
+/**
+ * Brings a decoder that has finished on a worker thread back to the
+ * job's thread, where it's handed over to the job if the job is still
+ * there. Lives in the job's thread and deletes itself once delivered.
+ */
+class BaseJob::Private::Delivery: public QObject
+{
+    public:
+        Delivery(BaseJob* j, QSharedPointer<Decoder> dec)
+            : job(j), decoder(dec) {}
+
+        bool event(QEvent* e) override
+        {
+            if( e->type() != QEvent::User )
+                return QObject::event(e);
+            if( job )
+                job->gotDecodedReply(decoder.data());
+            deleteLater();
+            return true;
+        }
+
+        QPointer<BaseJob> job;
+        QSharedPointer<Decoder> decoder;
 };
 
+class BaseJob::Private::Runner: public QRunnable
+{
+    public:
+        Runner(Delivery* d, QByteArray b) : delivery(d), bytes(b) {}
+
+        void run() override
+        {
+            Decoder* decoder = delivery->decoder.data();
+            if( !decoder->isCancelled() )
+                decoder->error = decoder->decode(bytes);
+            // Not touched here after that; see Delivery::event()
+            QCoreApplication::postEvent(delivery, new QEvent(QEvent::User));
+        }
+
+    private:
+        Delivery* delivery;
+        QByteArray bytes;
+};
+
+BaseJob::Decoder::Decoder()
+{
+}
+
+BaseJob::Decoder::~Decoder()
+{
+}
+
+QString BaseJob::Decoder::decode(const QByteArray& data)
+{
+    QJsonParseError error;
+    json = QJsonDocument::fromJson(data, &error);
+    if( error.error != QJsonParseError::NoError )
+        return error.errorString();
+    decodeJson(json);
+    return QString();
+}
+
+void BaseJob::Decoder::decodeJson(const QJsonDocument& data)
+{
+}
+
+bool BaseJob::Decoder::isCancelled() const
+{
+    return cancelled.loadAcquire() != 0;
+}
+
+void BaseJob::Decoder::cancel()
+{
+    cancelled.storeRelease(1);
+}
+
 BaseJob::BaseJob(ConnectionData* connection, JobHttpType type, QString name, bool needsToken)
     : d(new Private(connection, type, needsToken))
 {
@@ -49,11 +219,22 @@ BaseJob::BaseJob(ConnectionData* connection, JobHttpType type, QString name, boo
         else
             emit failure(this);
     });
+    // Jobs that finish without going through checkReply() or fail()
+    // mustn't time out or retry afterwards
+    d->stopTimersOnFinish = connect(this, &KJob::finished, [this]() {
+        d->cancelTimer(d->timeoutId);
+        d->cancelTimer(d->retryId);
+    });
     setObjectName(name);
 }
 
 BaseJob::~BaseJob()
 {
+    d->cancelDecoder();
+    // ~KJob() emits finished() for unfinished jobs, after d is gone
+    disconnect(d->stopTimersOnFinish);
+    d->cancelTimer(d->timeoutId);
+    d->cancelTimer(d->retryId);
     if( d->reply )
     {
         if( d->reply->isRunning() )
@@ -78,12 +259,84 @@ QUrlQuery BaseJob::query() const
     return QUrlQuery();
 }
 
+void BaseJob::setParseInBackground(bool enable)
+{
+    d->parseInBackground = enable;
+}
+
+void BaseJob::setMaxAttempts(int attempts)
+{
+    d->maxAttempts = attempts;
+}
+
+int BaseJob::maxAttempts() const
+{
+    return d->maxAttempts;
+}
+
+void BaseJob::setRequestTimeout(int msec)
+{
+    d->requestTimeout = msec;
+}
+
+int BaseJob::requestTimeout() const
+{
+    return d->requestTimeout;
+}
+
+void BaseJob::setRequestHeader(const QByteArray& name, const QByteArray& value)
+{
+    if( value.isEmpty() )
+        d->requestHeaders.remove(name);
+    else
+        d->requestHeaders.insert(name, value);
+}
+
+void BaseJob::setPriority(JobPriority priority)
+{
+    d->priority = priority;
+}
+
+JobPriority BaseJob::priority() const
+{
+    return d->priority;
+}
+
+void BaseJob::beforeRetry()
+{
+}
+
+BaseJob::Decoder* BaseJob::createDecoder() const
+{
+    return new Decoder;
+}
+
+BaseJob::Decoder* BaseJob::decoder() const
+{
+    return d->decoder.data();
+}
+
 void BaseJob::parseJson(const QJsonDocument& data)
 {
 }
 
 void BaseJob::start()
 {
+    d->attempt = 0;
+    d->connection->scheduler()->schedule(this);
+}
+
+void BaseJob::sendRequest()
+{
+    d->retryId = 0;
+    if( d->reply )
+    {
+        d->reply->deleteLater();
+        d->reply = nullptr;
+        beforeRetry();
+    }
+    ++d->attempt;
+
     QUrl url = d->connection->baseUrl();
     url.setPath( url.path() + "/" + apiPath() );
     QUrlQuery query = this->query();
@@ -92,36 +345,95 @@ void BaseJob::start()
     url.setQuery(query);
     QNetworkRequest req = QNetworkRequest(url);
     req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+    for( auto it = d->requestHeaders.constBegin(); it != d->requestHeaders.constEnd(); ++it )
+        req.setRawHeader(it.key(), it.value());
+    switch( d->priority )
+    {
+        case JobPriority::Sync:
+        case JobPriority::Send:
+            req.setPriority(QNetworkRequest::HighPriority);
+            break;
+        case JobPriority::Backfill:
+        case JobPriority::Media:
+            req.setPriority(QNetworkRequest::LowPriority);
+            break;
+        default:
+            break;
+    }
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 6, 0))
     req.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
     req.setMaximumRedirectsAllowed(10);
+#endif
+    // Lets the requests of all connections sharing a network access
+    // manager go over one multiplexed connection to the server
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    req.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+#elif (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    req.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
 #endif
     QJsonDocument data = QJsonDocument(this->data());
+    if( d->requestData && !d->requestData->seek(0) )
+    {
+        fail( UserDefinedError, "Can't rewind the request data: " + d->requestData->errorString() );
+        return;
+    }
     switch( d->type )
     {
         case JobHttpType::GetJob:
             d->reply = d->connection->nam()->get(req);
             break;
         case JobHttpType::PostJob:
-            d->reply = d->connection->nam()->post(req, data.toJson());
+            if( d->requestData )
+                d->reply = d->connection->nam()->post(req, d->requestData);
+            else
+                d->reply = d->connection->nam()->post(req, data.toJson());
             break;
         case JobHttpType::PutJob:
-            d->reply = d->connection->nam()->put(req, data.toJson());
+            if( d->requestData )
+                d->reply = d->connection->nam()->put(req, d->requestData);
+            else
+                d->reply = d->connection->nam()->put(req, data.toJson());
             break;
     }
+    if( d->requestData )
+        connect( d->reply, &QNetworkReply::uploadProgress, this, &BaseJob::gotUploadProgress );
     connect( d->reply, &QNetworkReply::sslErrors, this, &BaseJob::sslErrors );
+    connect( d->reply, &QNetworkReply::readyRead, this, &BaseJob::gotPartialReply );
     connect( d->reply, &QNetworkReply::finished, this, &BaseJob::gotReply );
-    QTimer::singleShot( 120*1000, this, SLOT(timeout()) );
+    resetTimeout();
 //     connect( d->reply, static_cast<void(QNetworkReply::*)(QNetworkReply::NetworkError)>(&QNetworkReply::error),
 //              this, &BaseJob::networkError ); // http://doc.qt.io/qt-5/qnetworkreply.html#error-1
 }
 
+void BaseJob::resetTimeout()
+{
+    d->cancelTimer(d->timeoutId);
+    if( d->wheel )
+        d->timeoutId = d->wheel->start(d->requestTimeout, [this] {
+            d->timeoutId = 0;
+            timeout();
+        });
+}
+
+void BaseJob::setRequestData(QIODevice* device)
+{
+    d->requestData = device;
+}
+
+void BaseJob::gotUploadProgress(qint64 bytesSent, qint64 bytesTotal)
+{
+    if( bytesTotal > 0 )
+        setTotalAmount(KJob::Bytes, bytesTotal);
+    setProcessedAmount(KJob::Bytes, bytesSent);
+    resetTimeout();
+}
+
 void BaseJob::fail(int errorCode, QString errorString)
 {
     setError( errorCode );
     setErrorText( errorString );
-    if( d->reply->isRunning() )
-        d->reply->abort();
+    d->cancelTimer(d->retryId);
+    d->dropReply(this);
     qWarning() << "Job" << objectName() << "failed:" << errorString;
     emitResult();
 }
@@ -136,26 +448,117 @@ QNetworkReply* BaseJob::networkReply() const
 //     fail( KJob::UserDefinedError+1, d->reply->errorString() );
 // }
 
+void BaseJob::gotPartialReply()
+{
+}
+
+bool BaseJob::checkReply()
+{
+    d->cancelTimer(d->timeoutId);
+    QNetworkReply* reply = d->reply;
+    if( reply->error() == QNetworkReply::NoError )
+        return true;
+
+    const int httpCode =
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    int retryAfter = -1;
+    if( httpCode == 429 ) // M_LIMIT_EXCEEDED
+    {
+        const QJsonObject json = QJsonDocument::fromJson(reply->readAll()).object();
+        if( json.contains("retry_after_ms") )
+            retryAfter = json.value("retry_after_ms").toInt();
+    }
+    if( retryAfter < 0 && reply->hasRawHeader("Retry-After") )
+    {
+        bool ok = false;
+        const int seconds = reply->rawHeader("Retry-After").toInt(&ok);
+        if( ok )
+            retryAfter = seconds * 1000;
+    }
+    // httpCode is 0 if the request didn't get through to the server
+    const bool transient = httpCode == 429 ||
+        ( d->isIdempotent() && (httpCode >= 500 || httpCode == 0) );
+    if( transient && d->canRetry() )
+    {
+        qDebug() << "Job" << objectName() << "attempt" << d->attempt
+                 << "failed:" << reply->errorString();
+        scheduleRetry(retryAfter >= 0 ? retryAfter : d->backoffDelay());
+        return false;
+    }
+    qDebug() << "NetworkError:" << reply->error();
+    fail( NetworkError, reply->errorString() );
+    return false;
+}
+
+bool BaseJob::retry()
+{
+    if( !d->canRetry() )
+        return false;
+    scheduleRetry(d->backoffDelay());
+    return true;
+}
+
+void BaseJob::scheduleRetry(int delay)
+{
+    d->dropReply(this);
+    qDebug() << "Job" << objectName() << "will retry in" << delay << "ms";
+    emit transientFailure(this);
+    if( d->wheel )
+        d->retryId = d->wheel->start(delay, [this] { sendRequest(); });
+}
+
 void BaseJob::gotReply()
 {
-    if( d->reply->error() != QNetworkReply::NoError )
+    if( !checkReply() )
+        return;
+    processReplyData(d->reply->readAll());
+}
+
+void BaseJob::processReplyData(const QByteArray& data)
+{
+    d->cancelDecoder();
+    d->decoder = QSharedPointer<Decoder>(createDecoder());
+    if( d->parseInBackground )
     {
-        qDebug() << "NetworkError:" << d->reply->error();
-        fail( NetworkError, d->reply->errorString() );
+        auto delivery = new Private::Delivery(this, d->decoder);
+        QThreadPool::globalInstance()->start(new Private::Runner(delivery, data));
         return;
     }
-    QJsonParseError error;
-    QJsonDocument data = QJsonDocument::fromJson(d->reply->readAll(), &error);
-    if( error.error != QJsonParseError::NoError )
+    d->decoder->error = d->decoder->decode(data);
+    gotDecodedReply(d->decoder.data());
+}
+
+void BaseJob::gotDecodedReply(Decoder* decoder)
+{
+    // Decoders of killed or restarted jobs are ignored
+    if( decoder != d->decoder.data() || decoder->isCancelled() )
+        return;
+    if( !decoder->error.isEmpty() )
     {
-        fail( JsonParseError, error.errorString() );
+        fail( JsonParseError, decoder->error );
         return;
     }
+    QJsonDocument data = decoder->json;
+    decoder->json = QJsonDocument();
     parseJson(data);
 }
 
+bool BaseJob::doKill()
+{
+    d->cancelDecoder();
+    d->cancelTimer(d->retryId);
+    d->dropReply(this);
+    return true;
+}
+
 void BaseJob::timeout()
 {
+    if( d->isIdempotent() && d->canRetry() )
+    {
+        qDebug() << "Job" << objectName() << "attempt" << d->attempt << "has timed out";
+        scheduleRetry(d->backoffDelay());
+        return;
+    }
     fail( TimeoutError, "The job has timed out" );
 }
 
@@ -25,6 +25,7 @@
 #include "kjob.h"
 #endif // KCOREADDONS_FOUND
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QJsonDocument>
 #include <QtCore/QJsonObject>
 #include <QtCore/QUrlQuery>
@@ -35,6 +36,13 @@ namespace QMatrixClient
     class ConnectionData;
 
     enum class JobHttpType { GetJob, PutJob, PostJob };
+    /**
+     * Classes of jobs for JobScheduler, from the most to the least urgent.
+     * Interactive requests without a better fitting class go as Send.
+     */
+    enum class JobPriority { Sync, Send, Receipt, Backfill, Media };
+
+    static const int DefaultRequestTimeout = 120 * 1000;
     
     class BaseJob: public KJob
     {
@@ -46,6 +54,46 @@ namespace QMatrixClient
 
             void start() override;
 
+            /**
+             * Makes the job parse the reply on a worker thread from
+             * QThreadPool::globalInstance(). Only the job's Decoder is
+             * run there; parseJson() and the signals are still delivered
+             * in the thread the job lives in. Killing or deleting the job
+             * doesn't wait for the decoder: its results are dropped.
+             */
+            void setParseInBackground(bool enable);
+            /**
+             * Sets how many times in total the request may be sent before
+             * the job fails. Rate-limited requests (HTTP 429) are retried
+             * for any job; server errors (5xx), network errors and
+             * timeouts only for GET and PUT requests. Attempts are spaced
+             * with a jittered exponential backoff, or as long as the
+             * server asks via retry_after_ms or Retry-After. The default
+             * is 3; 1 disables retrying.
+             */
+            void setMaxAttempts(int attempts);
+            int maxAttempts() const;
+            /**
+             * Sets the class the job is scheduled in (see JobScheduler);
+             * it also sets the priority of the network request.
+             * Only has effect before start().
+             */
+            void setPriority(JobPriority priority);
+            JobPriority priority() const;
+            /**
+             * Sets how long to wait for a reply to each attempt before
+             * giving up on it, in ms. The default is 120 seconds; jobs
+             * that need a different one set it in their constructors.
+             */
+            void setRequestTimeout(int msec);
+            int requestTimeout() const;
+            /**
+             * Adds a header to the request, replacing the previous value
+             * if there's one; an empty value removes the header. Takes
+             * effect from the next attempt.
+             */
+            void setRequestHeader(const QByteArray& name, const QByteArray& value);
+
             enum ErrorCode { NetworkError = KJob::UserDefinedError,
                              JsonParseError, TimeoutError, UserDefinedError };
 
@@ -56,32 +104,148 @@ namespace QMatrixClient
             void success(BaseJob*);
             /**
              * Emitted together with KJob::result() if there's an error.
+             * This is final: the job doesn't retry after that.
              * Same as result(), this won't be emitted in case of kill(Quietly).
              */
             void failure(BaseJob*);
+            /**
+             * Emitted when an attempt fails but the request is going
+             * to be sent again.
+             */
+            void transientFailure(BaseJob*);
 
         protected:
+            /**
+             * Does the heavy lifting of the reply processing (e.g.,
+             * creating Event objects) before parseJson(). If background
+             * parsing is enabled, it runs on a worker thread and may
+             * outlive the job, so it must only use what it has been given
+             * by createDecoder() and keep its results until the job takes
+             * them in parseJson(); results that are never taken should be
+             * freed by the destructor.
+             */
+            class Decoder
+            {
+                public:
+                    Decoder();
+                    virtual ~Decoder();
+
+                    /**
+                     * Turns the raw reply into results. The default
+                     * implementation parses the data as JSON into json
+                     * and passes it to decodeJson(); decoders of other
+                     * kinds of replies (e.g. images) override it, leaving
+                     * an empty document for parseJson(). Returns an error
+                     * message that fails the job with JsonParseError, or
+                     * an empty string.
+                     */
+                    virtual QString decode(const QByteArray& data);
+                    virtual void decodeJson(const QJsonDocument& data);
+
+                    /**
+                     * Whether the job has been killed or deleted; long
+                     * decoders may check it to stop early.
+                     */
+                    bool isCancelled() const;
+                    void cancel();
+
+                    QJsonDocument json;
+                    QString error;
+
+                private:
+                    QAtomicInt cancelled;
+            };
+
             ConnectionData* connection() const;
 
             // to implement
             virtual QString apiPath() const = 0;
             virtual QUrlQuery query() const;
             virtual QJsonObject data() const;
+            /**
+             * Creates a decoder for the reply that has just arrived,
+             * in the job's thread. The default one parses JSON.
+             */
+            virtual Decoder* createDecoder() const;
+            /**
+             * The decoder of the last reply; in parseJson() it has
+             * finished and the job can take its results.
+             */
+            Decoder* decoder() const;
             virtual void parseJson(const QJsonDocument& data);
+            /**
+             * Passes the data through a new decoder (in background if
+             * enabled) and parseJson(), as gotReply() does with the
+             * reply. For jobs that get their data elsewhere, e.g. from
+             * a cache.
+             */
+            void processReplyData(const QByteArray& data);
             
             void fail( int errorCode, QString errorString );
             QNetworkReply* networkReply() const;
+            /**
+             * Checks the reply for errors, scheduling another attempt or
+             * failing the job if there are any. Returns true if the reply
+             * can be processed. Jobs overriding gotReply() should call it
+             * first thing.
+             */
+            bool checkReply();
+            /**
+             * Restarts the timeout of the current attempt; jobs receiving
+             * or sending big payloads call it as data goes through, so
+             * that only stalled transfers time out.
+             */
+            void resetTimeout();
+            /**
+             * Drops the current reply and sends the request again after
+             * the usual backoff delay, if the attempt limit allows;
+             * returns false otherwise. For jobs that know how to recover
+             * from an error checkReply() would treat as permanent.
+             */
+            bool retry();
+            /**
+             * Makes POST and PUT requests send the contents of the device
+             * instead of data(). The device must be open, support seeking
+             * (it is rewound for every attempt) and stay alive until the
+             * job finishes. Upload progress is reported through KJob's
+             * processed and total amounts in bytes.
+             */
+            void setRequestData(QIODevice* device);
+            /**
+             * Called before the request is sent again after a failed
+             * attempt; jobs that keep state from a partially received
+             * reply should reset it here.
+             */
+            virtual void beforeRetry();
+            /** Aborts the request without reporting an error */
+            bool doKill() override;
 
             
         protected slots:
+            /**
+             * Called every time a new portion of the reply arrives. The
+             * default implementation does nothing, leaving the data in
+             * the reply for gotReply(); jobs that process the reply
+             * incrementally should consume it with readAll() here.
+             */
+            virtual void gotPartialReply();
             virtual void gotReply();
             void timeout();
             void sslErrors(const QList<QSslError>& errors);
 
             //void networkError(QNetworkReply::NetworkError code);
 
+        private slots:
+            /** Called by JobScheduler when the job's turn comes */
+            void sendRequest();
+            void gotUploadProgress(qint64 bytesSent, qint64 bytesTotal);
+
+        private:
+            void scheduleRetry(int delay);
+            void gotDecodedReply(Decoder* decoder);
 
         private:
+            friend class JobScheduler;
             class Private;
             Private* d;
     };
@@ -0,0 +1,75 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "definefilterjob.h"
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QDebug>
+
+#include "../filter.h"
+
+using namespace QMatrixClient;
+
+class DefineFilterJob::Private
+{
+    public:
+        QString userId;
+        QJsonObject filter;
+        QString filterId;
+};
+
+DefineFilterJob::DefineFilterJob(ConnectionData* data, QString userId, const Filter& filter)
+    : BaseJob(data, JobHttpType::PostJob, "DefineFilterJob")
+    , d(new Private)
+{
+    d->userId = userId;
+    d->filter = filter.toJson();
+}
+
+DefineFilterJob::~DefineFilterJob()
+{
+    delete d;
+}
+
+QString DefineFilterJob::filterId() const
+{
+    return d->filterId;
+}
+
+QString DefineFilterJob::apiPath() const
+{
+    return QString("_matrix/client/r0/user/%1/filter").arg(d->userId);
+}
+
+QJsonObject DefineFilterJob::data() const
+{
+    return d->filter;
+}
+
+void DefineFilterJob::parseJson(const QJsonDocument& data)
+{
+    QJsonObject json = data.object();
+    if( !json.contains("filter_id") )
+    {
+        fail( BaseJob::UserDefinedError, "No filter_id in the reply" );
+        qDebug() << data;
+        return;
+    }
+    d->filterId = json.value("filter_id").toString();
+    emitResult();
+}
@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "jobscheduler.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QQueue>
+
+using namespace QMatrixClient;
+
+static const int PriorityCount = int(JobPriority::Media) + 1;
+
+class JobScheduler::Private
+{
+    public:
+        int limits[PriorityCount];
+        int running[PriorityCount];
+        QQueue<BaseJob*> queues[PriorityCount];
+        /** Running jobs and the classes they took their slots in */
+        QHash<QObject*, int> runningJobs;
+
+        void run(BaseJob* job, int priority);
+};
+
+JobScheduler::JobScheduler(QObject* parent)
+    : QObject(parent)
+    , d(new Private)
+{
+    for( int i = 0; i < PriorityCount; ++i )
+        d->running[i] = 0;
+    d->limits[int(JobPriority::Sync)] = 2;
+    d->limits[int(JobPriority::Send)] = 4;
+    d->limits[int(JobPriority::Receipt)] = 2;
+    d->limits[int(JobPriority::Backfill)] = 2;
+    d->limits[int(JobPriority::Media)] = 4;
+}
+
+JobScheduler::~JobScheduler()
+{
+    delete d;
+}
+
+void JobScheduler::setLimit(JobPriority priority, int maxRunningJobs)
+{
+    const int i = int(priority);
+    d->limits[i] = maxRunningJobs;
+    while( d->running[i] < d->limits[i] && !d->queues[i].isEmpty() )
+        d->run(d->queues[i].dequeue(), i);
+}
+
+int JobScheduler::limit(JobPriority priority) const
+{
+    return d->limits[int(priority)];
+}
+
+int JobScheduler::runningJobs(JobPriority priority) const
+{
+    return d->running[int(priority)];
+}
+
+int JobScheduler::queuedJobs(JobPriority priority) const
+{
+    return d->queues[int(priority)].size();
+}
+
+bool JobScheduler::hasJobs() const
+{
+    if( !d->runningJobs.isEmpty() )
+        return true;
+    for( const QQueue<BaseJob*>& queue: d->queues )
+    {
+        if( !queue.isEmpty() )
+            return true;
+    }
+    return false;
+}
+
+void JobScheduler::schedule(BaseJob* job)
+{
+    connect( job, &KJob::finished, this, &JobScheduler::release, Qt::UniqueConnection );
+    connect( job, &QObject::destroyed, this, &JobScheduler::release, Qt::UniqueConnection );
+    const int i = int(job->priority());
+    if( d->running[i] < d->limits[i] )
+        d->run(job, i);
+    else
+        d->queues[i].enqueue(job);
+}
+
+void JobScheduler::Private::run(BaseJob* job, int priority)
+{
+    ++running[priority];
+    runningJobs.insert(job, priority);
+    job->sendRequest();
+}
+
+void JobScheduler::release(QObject* job)
+{
+    if( !d->runningJobs.contains(job) )
+    {
+        // The job may be half-destroyed, so only compare the pointers
+        for( QQueue<BaseJob*>& queue: d->queues )
+        {
+            for( auto it = queue.begin(); it != queue.end(); ++it )
+            {
+                if( static_cast<QObject*>(*it) == job )
+                {
+                    queue.erase(it);
+                    return;
+                }
+            }
+        }
+        return;
+    }
+    const int i = d->runningJobs.take(job);
+    --d->running[i];
+    if( d->running[i] < d->limits[i] && !d->queues[i].isEmpty() )
+        d->run(d->queues[i].dequeue(), i);
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_JOBSCHEDULER_H
+#define QMATRIXCLIENT_JOBSCHEDULER_H
+
+#include <QtCore/QObject>
+
+#include "basejob.h"
+
+namespace QMatrixClient
+{
+    /**
+     * Decides when started jobs actually send their requests. Each
+     * JobPriority class has its own limit of concurrently running jobs;
+     * jobs beyond it wait in a per-class queue, so that a flood of media
+     * requests can't delay syncs or message sends. A job holds its slot
+     * until it finishes, including the time it waits between attempts.
+     */
+    class JobScheduler: public QObject
+    {
+            Q_OBJECT
+        public:
+            explicit JobScheduler(QObject* parent = nullptr);
+            virtual ~JobScheduler();
+
+            void setLimit(JobPriority priority, int maxRunningJobs);
+            int limit(JobPriority priority) const;
+            int runningJobs(JobPriority priority) const;
+            int queuedJobs(JobPriority priority) const;
+            /** Whether any job of any class is running or queued */
+            bool hasJobs() const;
+
+            /** Sends the job's request now if its class has a free slot, queues the job otherwise */
+            void schedule(BaseJob* job);
+
+        public slots:
+            /**
+             * Removes the job from its queue, or frees its slot and starts
+             * the next queued job if it was running. Called automatically
+             * when a job finishes, is killed or deleted.
+             */
+            void release(QObject* job);
+
+        private:
+            class Private;
+            Private* d;
+    };
+}
+
+#endif // QMATRIXCLIENT_JOBSCHEDULER_H
@@ -0,0 +1,227 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mediadownloadjob.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QScopedPointer>
+#include <QtCore/QDebug>
+#include <QtNetwork/QNetworkReply>
+
+using namespace QMatrixClient;
+
+class MediaDownloadJob::Private
+{
+    public:
+        QUrl url;
+        QString localFilePath;
+        QFile partFile;
+        QByteArray expectedChecksum;
+        QCryptographicHash::Algorithm algorithm;
+        QScopedPointer<QCryptographicHash> hash;
+        bool replyChecked;
+
+        /** Feeds what's already in the .part file to the hash */
+        void hashPartFile();
+        /** Starts over if the server sends the whole content */
+        void restart();
+};
+
+void MediaDownloadJob::Private::hashPartFile()
+{
+    hash->reset();
+    QFile file(partFile.fileName());
+    if( !file.open(QIODevice::ReadOnly) )
+        return;
+    while( !file.atEnd() )
+        hash->addData(file.read(64 * 1024));
+}
+
+void MediaDownloadJob::Private::restart()
+{
+    partFile.resize(0);
+    partFile.seek(0);
+    if( hash )
+        hash->reset();
+}
+
+MediaDownloadJob::MediaDownloadJob(ConnectionData* data, QUrl url, QString localFilePath)
+    : BaseJob(data, JobHttpType::GetJob, "MediaDownloadJob")
+    , d(new Private)
+{
+    setPriority(JobPriority::Media);
+    setRequestTimeout(30 * 1000);
+    d->url = url;
+    d->localFilePath = localFilePath;
+    d->partFile.setFileName(localFilePath + ".part");
+    d->algorithm = QCryptographicHash::Sha256;
+    d->replyChecked = false;
+}
+
+MediaDownloadJob::~MediaDownloadJob()
+{
+    delete d;
+}
+
+void MediaDownloadJob::setExpectedChecksum(const QByteArray& checksum,
+                                           QCryptographicHash::Algorithm algorithm)
+{
+    d->expectedChecksum = checksum;
+    d->algorithm = algorithm;
+    d->hash.reset(checksum.isEmpty() ? nullptr : new QCryptographicHash(algorithm));
+}
+
+QString MediaDownloadJob::localFilePath() const
+{
+    return d->localFilePath;
+}
+
+void MediaDownloadJob::start()
+{
+    if( d->hash )
+        d->hashPartFile();
+    beforeRetry();
+    BaseJob::start();
+}
+
+QString MediaDownloadJob::apiPath() const
+{
+    return QString("/_matrix/media/v1/download/%1/%2").arg(d->url.host()).arg(d->url.path());
+}
+
+void MediaDownloadJob::beforeRetry()
+{
+    d->replyChecked = false;
+    const qint64 offset = d->partFile.size();
+    setRequestHeader("Range",
+        offset > 0 ? "bytes=" + QByteArray::number(offset) + "-" : QByteArray());
+}
+
+bool MediaDownloadJob::doKill()
+{
+    // Leave the .part file in place to resume from later
+    d->partFile.close();
+    return BaseJob::doKill();
+}
+
+void MediaDownloadJob::gotPartialReply()
+{
+    QNetworkReply* reply = networkReply();
+    const int httpCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if( httpCode != 200 && httpCode != 206 )
+        return; // Leave error replies to checkReply()
+
+    if( !d->replyChecked )
+    {
+        d->replyChecked = true;
+        if( !d->partFile.isOpen() )
+        {
+            if( !d->partFile.open(QIODevice::ReadWrite) )
+            {
+                fail( UserDefinedError, "Can't write to " + d->partFile.fileName() +
+                                        ": " + d->partFile.errorString() );
+                return;
+            }
+            d->partFile.seek(d->partFile.size());
+        }
+        if( httpCode == 200 && d->partFile.size() > 0 )
+        {
+            qDebug() << "MediaDownloadJob: the server can't resume, downloading"
+                     << d->url << "from the start";
+            d->restart();
+        }
+        const qint64 length = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+        if( length > 0 )
+            setTotalAmount(KJob::Bytes, d->partFile.size() + length);
+    }
+
+    const QByteArray chunk = reply->readAll();
+    if( chunk.isEmpty() )
+        return;
+    if( d->partFile.write(chunk) != chunk.size() )
+    {
+        fail( UserDefinedError, "Can't write to " + d->partFile.fileName() +
+                                ": " + d->partFile.errorString() );
+        return;
+    }
+    if( d->hash )
+        d->hash->addData(chunk);
+    setProcessedAmount(KJob::Bytes, d->partFile.size());
+    resetTimeout();
+}
+
+void MediaDownloadJob::gotReply()
+{
+    // Data that arrived after the last readyRead()
+    gotPartialReply();
+    if( error() )
+        return;
+
+    QNetworkReply* reply = networkReply();
+    const int httpCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if( httpCode == 416 && d->partFile.size() > 0 ) // Range Not Satisfiable
+    {
+        // The .part file may have all the content already, e.g. if a job
+        // was killed right before renaming it; the server tells the size
+        // of the content as "bytes */<size>"
+        const QByteArray range = reply->rawHeader("Content-Range");
+        bool sizeKnown = false;
+        const qint64 size = range.mid(range.indexOf('/') + 1).toLongLong(&sizeKnown);
+        if( sizeKnown && size == d->partFile.size() &&
+                (!d->hash || d->hash->result() == d->expectedChecksum) )
+        {
+            setTotalAmount(KJob::Bytes, size);
+            setProcessedAmount(KJob::Bytes, size);
+            finishDownload();
+            return;
+        }
+        qDebug() << "MediaDownloadJob: discarding" << d->partFile.fileName()
+                 << "that doesn't match" << d->url;
+        d->partFile.close();
+        d->partFile.remove();
+        if( d->hash )
+            d->hash->reset();
+        if( !retry() )
+            fail( NetworkError, reply->errorString() );
+        return;
+    }
+    if( !checkReply() )
+        return;
+    finishDownload();
+}
+
+void MediaDownloadJob::finishDownload()
+{
+    if( !d->partFile.isOpen() )
+        d->partFile.open(QIODevice::WriteOnly | QIODevice::Append); // Empty content
+    d->partFile.close();
+    if( d->hash && d->hash->result() != d->expectedChecksum )
+    {
+        d->partFile.remove();
+        fail( ChecksumMismatchError, "The checksum of " + d->url.toString() + " doesn't match" );
+        return;
+    }
+    QFile::remove(d->localFilePath);
+    if( !d->partFile.rename(d->localFilePath) )
+    {
+        fail( UserDefinedError, "Can't rename " + d->partFile.fileName() +
+                                ": " + d->partFile.errorString() );
+        return;
+    }
+    emitResult();
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_MEDIADOWNLOADJOB_H
+#define QMATRIXCLIENT_MEDIADOWNLOADJOB_H
+
+#include "basejob.h"
+
+#include <QtCore/QCryptographicHash>
+
+namespace QMatrixClient
+{
+    /**
+     * Downloads media content to a file, writing it out as it arrives.
+     *
+     * The data goes to localFilePath + ".part" first, which is renamed
+     * to localFilePath when the download completes. If a .part file is
+     * there already (from a killed or failed job, or a failed attempt
+     * of this one), the download resumes from its end with an HTTP Range
+     * request. If the server answers that the range is past the end of
+     * the content, the .part file is taken as complete when its size (and
+     * checksum, if one is set) match; otherwise it is discarded and the
+     * download starts over. Progress is reported with
+     * KJob::processedAmount() and totalAmount() in KJob::Bytes.
+     */
+    class MediaDownloadJob: public BaseJob
+    {
+            Q_OBJECT
+        public:
+            enum { ChecksumMismatchError = BaseJob::UserDefinedError + 1 };
+
+            MediaDownloadJob(ConnectionData* data, QUrl url, QString localFilePath);
+            virtual ~MediaDownloadJob();
+
+            /**
+             * Makes the job check the downloaded content against the hash
+             * (the raw digest, not its hex form) and fail with
+             * ChecksumMismatchError, removing the file, if they don't match.
+             */
+            void setExpectedChecksum(const QByteArray& checksum,
+                QCryptographicHash::Algorithm algorithm = QCryptographicHash::Sha256);
+
+            QString localFilePath() const;
+
+            void start() override;
+
+        protected:
+            QString apiPath() const override;
+            void beforeRetry() override;
+            bool doKill() override;
+
+        protected slots:
+            void gotPartialReply() override;
+            void gotReply() override;
+
+        private:
+            /** Checks the downloaded file and moves it in place */
+            void finishDownload();
+
+            class Private;
+            Private* d;
+    };
+}
+
+#endif // QMATRIXCLIENT_MEDIADOWNLOADJOB_H
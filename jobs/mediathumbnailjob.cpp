@@ -20,23 +20,75 @@
 
 #include <QtCore/QDebug>
 
+#include "../connectiondata.h"
+#include "../mediacache.h"
+
 using namespace QMatrixClient;
 
 class MediaThumbnailJob::Private
 {
     public:
+        class Decoder: public BaseJob::Decoder
+        {
+            public:
+                QString decode(const QByteArray& reply) override;
+
+                QUrl url;
+                QString cacheKey;
+                int requestedWidth;
+                int requestedHeight;
+                // Caches are never deleted, see MediaCache::forDirectory()
+                MediaCache* cache;
+                /** Whether the data to decode should come from the cache */
+                bool fromCache;
+                /** Set if the cache doesn't have the thumbnail */
+                bool cacheMiss;
+                QImage thumbnail;
+        };
+
         QUrl url;
-        QPixmap thumbnail;
+        QImage thumbnail;
         int requestedHeight;
         int requestedWidth;
         ThumbnailType thumbnailType;
+        MediaCache* cache;
+        int requesters;
+        /** Whether the thumbnail is being looked up in the cache */
+        bool fromCache;
+
+        /** The size to ask the server for */
+        QSize downloadSize() const;
+        QString cacheKey() const;
 };
 
+QSize MediaThumbnailJob::Private::downloadSize() const
+{
+    // Cropped thumbnails have the requested aspect ratio, so they can't be
+    // taken from a bigger square
+    if( thumbnailType == ThumbnailType::Crop )
+        return QSize(requestedWidth, requestedHeight);
+    const int size = bucketSize(requestedWidth, requestedHeight);
+    return QSize(size, size);
+}
+
+QString MediaThumbnailJob::Private::cacheKey() const
+{
+    const QSize size = downloadSize();
+    return MediaCache::thumbnailKey(url, size.width(), size.height(),
+        thumbnailType == ThumbnailType::Scale ? "scale" : "crop");
+}
+
 MediaThumbnailJob::MediaThumbnailJob(ConnectionData* data, QUrl url, int requestedWidth, int requestedHeight,
                                      ThumbnailType thumbnailType)
     : BaseJob(data, JobHttpType::GetJob, "MediaThumbnailJob")
     , d(new Private)
 {
+    setPriority(JobPriority::Media);
+    setRequestTimeout(30 * 1000);
+    setParseInBackground(true);
+    d->fromCache = false;
+    d->requesters = 1;
+    d->cache = data->mediaCache();
     d->url = url;
     d->requestedHeight = requestedHeight;
     d->requestedWidth = requestedWidth;
@@ -49,10 +101,55 @@ MediaThumbnailJob::~MediaThumbnailJob()
 }
 
 QPixmap MediaThumbnailJob::thumbnail()
+{
+    return QPixmap::fromImage(d->thumbnail);
+}
+
+QImage MediaThumbnailJob::thumbnailImage() const
 {
     return d->thumbnail;
 }
 
+int MediaThumbnailJob::bucketSize(int width, int height)
+{
+    static const int buckets[] = { 32, 96, 320, 640, 800 };
+    for( int bucket: buckets )
+    {
+        if( bucket >= width && bucket >= height )
+            return bucket;
+    }
+    return buckets[sizeof(buckets) / sizeof(buckets[0]) - 1];
+}
+
+void MediaThumbnailJob::start()
+{
+    // The cache is looked up by the decoder, off the caller's thread;
+    // the lookup is queued so that the caller connects to the job first
+    d->fromCache = true;
+    QMetaObject::invokeMethod(this, "lookUpCache", Qt::QueuedConnection);
+}
+
+void MediaThumbnailJob::addRequester()
+{
+    ++d->requesters;
+}
+
+bool MediaThumbnailJob::doKill()
+{
+    // Others still wait for the thumbnail
+    if( d->requesters > 1 )
+    {
+        --d->requesters;
+        return false;
+    }
+    return BaseJob::doKill();
+}
+
+void MediaThumbnailJob::lookUpCache()
+{
+    processReplyData(QByteArray());
+}
+
 QString MediaThumbnailJob::apiPath() const
 {
     return QString("/_matrix/media/v1/thumbnail/%1/%2").arg(d->url.host()).arg(d->url.path());
@@ -60,9 +157,10 @@ QString MediaThumbnailJob::apiPath() const
 
 QUrlQuery MediaThumbnailJob::query() const
 {
+    const QSize size = d->downloadSize();
     QUrlQuery query;
-    query.addQueryItem("width", QString::number(d->requestedWidth));
-    query.addQueryItem("height", QString::number(d->requestedHeight));
+    query.addQueryItem("width", QString::number(size.width()));
+    query.addQueryItem("height", QString::number(size.height()));
     if( d->thumbnailType == ThumbnailType::Scale )
         query.addQueryItem("method", "scale");
     else
@@ -70,19 +168,65 @@ QUrlQuery MediaThumbnailJob::query() const
     return query;
 }
 
-void MediaThumbnailJob::gotReply()
+QString MediaThumbnailJob::Private::Decoder::decode(const QByteArray& reply)
 {
-    if( networkReply()->error() != QNetworkReply::NoError )
+    QByteArray data = reply;
+    cacheMiss = false;
+    if( fromCache )
     {
-        qDebug() << "NetworkError!!!";
-        qDebug() << networkReply()->errorString();
-        fail( NetworkError, networkReply()->errorString() );
-        return;
+        data = cache->find(cacheKey);
+        if( data.isEmpty() )
+        {
+            cacheMiss = true;
+            return QString();
+        }
     }
-
-    if( !d->thumbnail.loadFromData( networkReply()->readAll() ) )
+    QImage image;
+    if( !image.loadFromData(data) )
     {
         qDebug() << "MediaThumbnailJob: could not read image data";
+        if( fromCache )
+        {
+            qDebug() << "MediaThumbnailJob: dropping unreadable cached image for" << url;
+            cache->remove(cacheKey);
+            cacheMiss = true;
+        }
+        return QString();
+    }
+    if( !fromCache )
+        cache->insert(cacheKey, data);
+    const QSize size =
+        image.size().scaled(requestedWidth, requestedHeight, Qt::KeepAspectRatio);
+    if( size != image.size() )
+        image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    thumbnail = image;
+    return QString();
+}
+
+BaseJob::Decoder* MediaThumbnailJob::createDecoder() const
+{
+    auto decoder = new Private::Decoder;
+    decoder->url = d->url;
+    decoder->cacheKey = d->cacheKey();
+    decoder->requestedWidth = d->requestedWidth;
+    decoder->requestedHeight = d->requestedHeight;
+    decoder->cache = d->cache;
+    decoder->fromCache = d->fromCache;
+    return decoder;
+}
+
+void MediaThumbnailJob::parseJson(const QJsonDocument&)
+{
+    auto decoder = static_cast<Private::Decoder*>(this->decoder());
+    if( d->fromCache )
+    {
+        d->fromCache = false;
+        if( decoder->cacheMiss )
+        {
+            BaseJob::start();
+            return;
+        }
     }
+    d->thumbnail = decoder->thumbnail;
     emitResult();
 }
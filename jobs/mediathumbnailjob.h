@@ -22,6 +22,7 @@
 #include "basejob.h"
 
 #include <QtGui/QPixmap>
+#include <QtGui/QImage>
 
 namespace QMatrixClient
 {
@@ -35,14 +36,52 @@ namespace QMatrixClient
                               ThumbnailType thumbnailType=ThumbnailType::Scale);
             virtual ~MediaThumbnailJob();
 
+            /**
+             * The thumbnail, scaled to fit the requested size. Scaled
+             * thumbnails are downloaded (and cached on disk) in the
+             * standard size that fits the request (see bucketSize()), so
+             * requests for similar sizes share one download. Converting
+             * the image to a pixmap is the only image processing done in
+             * the job's thread; decoding and scaling happen on a worker
+             * thread.
+             */
             QPixmap thumbnail();
+            QImage thumbnailImage() const;
+
+            /**
+             * Snaps a requested size to one of the standard thumbnail
+             * sizes (32, 96, 320, 640 and 800 px squares), returning the
+             * smallest one that fits the request, or the biggest one.
+             * Requesting those sizes lets different views share one
+             * thumbnail and servers serve pregenerated ones.
+             */
+            static int bucketSize(int width, int height);
+
+            /**
+             * Takes the thumbnail from the media cache of the connection
+             * if it's there, downloads it otherwise. The cache is read
+             * (and downloads are written to it) on the worker thread.
+             */
+            void start() override;
+
+            /**
+             * Counts one more holder of the job, for jobs shared between
+             * several requesters (see Connection::getThumbnail()). Each
+             * requester's kill() only drops its own claim: the job stops
+             * when the last one kills it, and kill() returns false before
+             * that. The job starts with one requester.
+             */
+            void addRequester();
 
         protected:
             QString apiPath() const override;
             QUrlQuery query() const override;
+            Decoder* createDecoder() const override;
+            void parseJson(const QJsonDocument& data) override;
+            bool doKill() override;
 
-        protected slots:
-            void gotReply() override;
+        private slots:
+            void lookUpCache();
 
         private:
             class Private;
@@ -0,0 +1,262 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mediauploadjob.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QIODevice>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QDebug>
+
+#include "../connectiondata.h"
+
+using namespace QMatrixClient;
+
+class MediaUploadJob::Private
+{
+    public:
+        /**
+         * The source device belongs to the caller, who may delete it as
+         * soon as the job is killed or deleted; the hasher reads it in
+         * small chunks under the lock, and the job takes the device away
+         * under the same lock, waiting for one chunk at most.
+         */
+        class SharedSource
+        {
+            public:
+                QMutex mutex;
+                QIODevice* device;
+        };
+        class Hasher: public BaseJob::Decoder
+        {
+            public:
+                QString decode(const QByteArray&) override;
+                /** Returns an error message or an empty string */
+                QString hashContent();
+
+                QSharedPointer<SharedSource> source;
+                QString contentType;
+                QByteArray contentHash;
+                QString hashError;
+        };
+
+        QSharedPointer<SharedSource> source;
+        QString contentType;
+        QString fileName;
+        QByteArray contentHash;
+        QUrl contentUri;
+        bool reusedUpload;
+        /** Whether the decoder should hash the content rather than a reply */
+        bool hashing;
+
+        void detachSource();
+};
+
+void MediaUploadJob::Private::detachSource()
+{
+    QMutexLocker locker(&source->mutex);
+    source->device = nullptr;
+}
+
+QString MediaUploadJob::Private::Hasher::decode(const QByteArray&)
+{
+    // Not a JsonParseError, see MediaUploadJob::parseJson()
+    hashError = hashContent();
+    return QString();
+}
+
+QString MediaUploadJob::Private::Hasher::hashContent()
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QMutexLocker locker(&source->mutex);
+    // Nobody waits for the results of a cancelled job
+    if( !source->device || isCancelled() )
+        return QString();
+    if( !source->device->seek(0) )
+        return "Can't rewind the content: " + source->device->errorString();
+    while( true )
+    {
+        // Let the job take the device away between chunks
+        locker.unlock();
+        locker.relock();
+        QIODevice* device = source->device;
+        if( !device || isCancelled() )
+            return QString();
+        if( device->atEnd() )
+            break;
+        const QByteArray chunk = device->read(64 * 1024);
+        if( chunk.isEmpty() )
+        {
+            if( !device->atEnd() )
+                return "Can't read the content: " + device->errorString();
+            break;
+        }
+        hash.addData(chunk);
+    }
+    if( !source->device->seek(0) )
+        return "Can't rewind the content: " + source->device->errorString();
+    // The content type is a part of what the server stores
+    hash.addData(contentType.toUtf8());
+    contentHash = hash.result();
+    return QString();
+}
+
+MediaUploadJob::MediaUploadJob(ConnectionData* data, QIODevice* source,
+                               QString contentType, QString fileName)
+    : BaseJob(data, JobHttpType::PostJob, "MediaUploadJob")
+    , d(new Private)
+{
+    setPriority(JobPriority::Media);
+    setRequestTimeout(30 * 1000);
+    setParseInBackground(true);
+    d->hashing = false;
+    d->source.reset(new Private::SharedSource);
+    d->source->device = source;
+    d->contentType = contentType;
+    d->fileName = fileName;
+    d->reusedUpload = false;
+    if( !source->isOpen() )
+        source->open(QIODevice::ReadOnly);
+    setRequestData(source);
+    setRequestHeader("Content-Type", contentType.toLatin1());
+}
+
+MediaUploadJob::~MediaUploadJob()
+{
+    d->detachSource();
+    delete d;
+}
+
+QUrl MediaUploadJob::contentUri() const
+{
+    return d->contentUri;
+}
+
+bool MediaUploadJob::reusedUpload() const
+{
+    return d->reusedUpload;
+}
+
+void MediaUploadJob::start()
+{
+    d->hashing = true;
+    // Let the caller connect to the job's signals first
+    QMetaObject::invokeMethod(this, "hashContent", Qt::QueuedConnection);
+}
+
+void MediaUploadJob::hashContent()
+{
+    // The content is read once for the hash and again for every attempt
+    // to upload it
+    QIODevice* source = d->source->device;
+    if( !source->isOpen() || source->isSequential() )
+    {
+        fail( UserDefinedError, "The content to upload must come from an open, seekable device" );
+        return;
+    }
+    processReplyData(QByteArray());
+}
+
+BaseJob::Decoder* MediaUploadJob::createDecoder() const
+{
+    if( !d->hashing )
+        return BaseJob::createDecoder();
+    auto hasher = new Private::Hasher;
+    hasher->source = d->source;
+    hasher->contentType = d->contentType;
+    return hasher;
+}
+
+bool MediaUploadJob::doKill()
+{
+    // The caller may delete the device right after this
+    d->detachSource();
+    return BaseJob::doKill();
+}
+
+QString MediaUploadJob::apiPath() const
+{
+    return QString("/_matrix/media/v1/upload");
+}
+
+QUrlQuery MediaUploadJob::query() const
+{
+    QUrlQuery query;
+    if( !d->fileName.isEmpty() )
+        query.addQueryItem("filename", d->fileName);
+    return query;
+}
+
+void MediaUploadJob::lookUpUpload()
+{
+    ConnectionData* data = connection();
+    const QByteArray contentHash = d->contentHash;
+    d->contentUri = data->uploadedContentUri(contentHash);
+    if( !d->contentUri.isEmpty() )
+    {
+        qDebug() << "MediaUploadJob: reusing" << d->contentUri;
+        d->reusedUpload = true;
+        emitResult();
+        return;
+    }
+    // Look again when the other upload finishes: its content URI is
+    // there if it succeeded, and this job uploads the content otherwise
+    if( BaseJob* upload = data->uploadInProgress(contentHash) )
+    {
+        qDebug() << "MediaUploadJob: waiting for the same content uploaded by" << upload;
+        connect( upload, &KJob::finished, this, &MediaUploadJob::lookUpUpload );
+        return;
+    }
+    data->addUploadInProgress(contentHash, this);
+    // Connected before any waiting job connects, so that the waiting jobs
+    // don't find this one; called from ~KJob() too, so it mustn't use d
+    connect( this, &KJob::finished, this, [=] () {
+        data->removeUploadInProgress(contentHash, this);
+    });
+    BaseJob::start();
+}
+
+void MediaUploadJob::parseJson(const QJsonDocument& data)
+{
+    if( d->hashing )
+    {
+        d->hashing = false;
+        auto hasher = static_cast<Private::Hasher*>(decoder());
+        if( !hasher->hashError.isEmpty() )
+        {
+            fail( UserDefinedError, hasher->hashError );
+            return;
+        }
+        d->contentHash = hasher->contentHash;
+        lookUpUpload();
+        return;
+    }
+
+    QJsonObject json = data.object();
+    if( !json.contains("content_uri") )
+    {
+        fail( BaseJob::UserDefinedError, "No content_uri in the reply" );
+        qDebug() << data;
+        return;
+    }
+    d->contentUri = QUrl(json.value("content_uri").toString());
+    connection()->addUploadedContent(d->contentHash, d->contentUri);
+    emitResult();
+}
@@ -0,0 +1,76 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_MEDIAUPLOADJOB_H
+#define QMATRIXCLIENT_MEDIAUPLOADJOB_H
+
+#include "basejob.h"
+
+class QIODevice;
+
+namespace QMatrixClient
+{
+    /**
+     * Uploads content from a device to the media repository, streaming
+     * it rather than reading it into memory. See BaseJob::setRequestData()
+     * for the requirements on the device.
+     *
+     * Before uploading, the job hashes the content (reading it through
+     * once, on a worker thread, so the device mustn't be used elsewhere
+     * until the job finishes) and looks the hash up among the uploads
+     * remembered by the connection; if the same content has been
+     * uploaded before, the job completes right away with the known
+     * content URI. If another job of the connection is uploading the
+     * same content, the job waits for it and takes its content URI, or
+     * uploads the content itself if that job fails. Sequential devices
+     * are rejected with an error.
+     */
+    class MediaUploadJob: public BaseJob
+    {
+            Q_OBJECT
+        public:
+            MediaUploadJob(ConnectionData* data, QIODevice* source,
+                           QString contentType, QString fileName = QString());
+            virtual ~MediaUploadJob();
+
+            /** The mxc:// URI of the uploaded content */
+            QUrl contentUri() const;
+            /** Whether the content was found among previous uploads */
+            bool reusedUpload() const;
+
+            void start() override;
+
+        protected:
+            QString apiPath() const override;
+            QUrlQuery query() const override;
+            Decoder* createDecoder() const override;
+            bool doKill() override;
+            void parseJson(const QJsonDocument& data) override;
+
+        private slots:
+            void hashContent();
+            /** Reuses an upload of the same content or starts one */
+            void lookUpUpload();
+
+        private:
+            class Private;
+            Private* d;
+    };
+}
+
+#endif // QMATRIXCLIENT_MEDIAUPLOADJOB_H
@@ -38,6 +38,7 @@ PostMessageJob::PostMessageJob(ConnectionData* connection, Room* room, QString t
     : BaseJob(connection, JobHttpType::PostJob, "PostMessageJob")
     , d(new Private)
 {
+    setRequestTimeout(30 * 1000);
     d->type = type;
     d->message = message;
     d->room = room;
@@ -37,6 +37,8 @@ PostReceiptJob::PostReceiptJob(ConnectionData* connection, QString roomId, QStri
     : BaseJob(connection, JobHttpType::PostJob, "PostReceiptJob")
     , d(new Private)
 {
+    setPriority(JobPriority::Receipt);
+    setRequestTimeout(30 * 1000);
     d->roomId = roomId;
     d->eventId = eventId;
 }
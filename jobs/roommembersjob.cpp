@@ -29,6 +29,15 @@ using namespace QMatrixClient;
 class RoomMembersJob::Private
 {
     public:
+        class Decoder: public BaseJob::Decoder
+        {
+            public:
+                ~Decoder();
+                void decodeJson(const QJsonDocument& data) override;
+
+                QList<State*> states;
+        };
+
         Room* room;
         QList<State*> states;
 };
@@ -37,6 +46,7 @@ RoomMembersJob::RoomMembersJob(ConnectionData* data, Room* room)
     : BaseJob(data, JobHttpType::GetJob, "RoomMembersJob")
     , d(new Private)
 {
+    setPriority(JobPriority::Backfill);
     d->room = room;
 }
 
@@ -45,6 +55,25 @@ RoomMembersJob::~RoomMembersJob()
     delete d;
 }
 
+RoomMembersJob::Private::Decoder::~Decoder()
+{
+    // Only left here if the job is gone
+    qDeleteAll(states);
+}
+
+void RoomMembersJob::Private::Decoder::decodeJson(const QJsonDocument& data)
+{
+    QJsonObject obj = data.object();
+    QJsonArray chunk = obj.value("chunk").toArray();
+    for( const QJsonValue& val : chunk )
+    {
+        State* state = State::fromJson(val.toObject());
+        if( state )
+            states.append(state);
+    }
+    qDebug() << "States: " << states.count();
+}
+
 QList< State* > RoomMembersJob::states()
 {
     return d->states;
@@ -55,16 +84,13 @@ QString RoomMembersJob::apiPath() const
     return QString("_matrix/client/r0/rooms/%1/members").arg(d->room->id());
 }
 
+BaseJob::Decoder* RoomMembersJob::createDecoder() const
+{
+    return new Private::Decoder;
+}
+
 void RoomMembersJob::parseJson(const QJsonDocument& data)
 {
-    QJsonObject obj = data.object();
-    QJsonArray chunk = obj.value("chunk").toArray();
-    for( const QJsonValue& val : chunk )
-    {
-        State* state = State::fromJson(val.toObject());
-        if( state )
-            d->states.append(state);
-    }
-    qDebug() << "States: " << d->states.count();
+    d->states.swap(static_cast<Private::Decoder*>(decoder())->states);
     emitResult();
 }
@@ -36,6 +36,7 @@ namespace QMatrixClient
 
         protected:
             virtual QString apiPath() const override;
+            virtual Decoder* createDecoder() const override;
             virtual void parseJson(const QJsonDocument& data) override;
 
         private:
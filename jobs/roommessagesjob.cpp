@@ -28,6 +28,16 @@ using namespace QMatrixClient;
 class RoomMessagesJob::Private
 {
     public:
+        class Decoder: public BaseJob::Decoder
+        {
+            public:
+                ~Decoder();
+                void decodeJson(const QJsonDocument& data) override;
+
+                QList<Event*> events;
+                QString end;
+        };
+
         Private() {}
 
         Room* room;
@@ -42,6 +52,7 @@ class RoomMessagesJob::Private
 RoomMessagesJob::RoomMessagesJob(ConnectionData* data, Room* room, QString from, FetchDirectory dir, int limit)
     : BaseJob(data, JobHttpType::GetJob, "RoomMessagesJob")
 {
+    setPriority(JobPriority::Backfill);
     d = new Private();
     d->room = room;
     d->from = from;
@@ -54,6 +65,19 @@ RoomMessagesJob::~RoomMessagesJob()
     delete d;
 }
 
+RoomMessagesJob::Private::Decoder::~Decoder()
+{
+    // Only left here if the job is gone
+    qDeleteAll(events);
+}
+
+void RoomMessagesJob::Private::Decoder::decodeJson(const QJsonDocument& data)
+{
+    QJsonObject obj = data.object();
+    events = eventListFromJson(obj.value("chunk").toArray());
+    end = obj.value("end").toString();
+}
+
 QList<Event*> RoomMessagesJob::events()
 {
     return d->events;
@@ -81,10 +105,15 @@ QUrlQuery RoomMessagesJob::query() const
     return query;
 }
 
+BaseJob::Decoder* RoomMessagesJob::createDecoder() const
+{
+    return new Private::Decoder;
+}
+
 void RoomMessagesJob::parseJson(const QJsonDocument& data)
 {
-    QJsonObject obj = data.object();
-    d->events = eventListFromJson(obj.value("chunk").toArray());
-    d->end = obj.value("end").toString();
+    auto decoder = static_cast<Private::Decoder*>(this->decoder());
+    d->events.swap(decoder->events);
+    d->end = decoder->end;
     emitResult();
 }
@@ -41,6 +41,7 @@ namespace QMatrixClient
         protected:
             QString apiPath() const override;
             QUrlQuery query() const override;
+            Decoder* createDecoder() const override;
             void parseJson(const QJsonDocument& data) override;
 
         private:
@@ -22,6 +22,11 @@
 #include <QtCore/QJsonObject>
 #include <QtCore/QJsonValue>
 #include <QtCore/QJsonArray>
+#include <QtCore/QVector>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
 #include <QtCore/QDebug>
 
 #include "../room.h"
@@ -33,6 +38,16 @@ using namespace QMatrixClient;
 class SyncJob::Private
 {
     public:
+        class Decoder: public BaseJob::Decoder
+        {
+            public:
+                ~Decoder();
+                void decodeJson(const QJsonDocument& data) override;
+
+                QString nextBatch;
+                QList<SyncRoomData> roomData;
+        };
+
         QString since;
         QString filter;
         bool fullState;
@@ -41,15 +56,202 @@ class SyncJob::Private
         QString nextBatch;
 
         QList<SyncRoomData> roomData;
+
+        // Streaming mode state
+        bool streaming;
+        QByteArray buffer; // Unscanned data or the room currently being received
+        QByteArray skeleton; // Everything outside of room objects
+        QVector<QByteArray> keys; // Current key at each nesting level
+        QByteArray lastString;
+        int scanPos;
+        bool inString;
+        bool escaped;
+        bool inRoom;
+        QString streamError;
+
+        void streamData(const QByteArray& chunk);
+        bool isAtRoomLevel(JoinState* joinState) const;
+        void finishRoom(const QByteArray& roomJson);
 };
 
+static const int SyncTimeoutSlack = 30 * 1000;
+
+/** Below this number of rooms, decoding in parallel doesn't pay off */
+static const int MinRoomsForParallelDecoding = 16;
+
+class ParallelRoomDecoder
+{
+    public:
+        class Helper: public QRunnable
+        {
+            public:
+                explicit Helper(ParallelRoomDecoder* d) : decoder(d) { }
+
+                void run() override
+                {
+                    decoder->decodeRooms();
+                    decoder->done.release();
+                }
+
+            private:
+                ParallelRoomDecoder* decoder;
+        };
+
+        struct RoomJson
+        {
+            QString id;
+            QJsonObject json;
+            JoinState joinState;
+        };
+
+        ParallelRoomDecoder() : nextRoom(0) { }
+
+        QVector<RoomJson> rooms;
+        QVector<SyncRoomData*> results;
+        QAtomicInt nextRoom;
+        QSemaphore done;
+
+        /** Takes rooms one by one until none are left; results keep the order of rooms */
+        void decodeRooms()
+        {
+            for( int i = nextRoom.fetchAndAddOrdered(1); i < rooms.size();
+                 i = nextRoom.fetchAndAddOrdered(1) )
+            {
+                const RoomJson& r = rooms.at(i);
+                results[i] = new SyncRoomData(r.id, r.json, r.joinState);
+            }
+        }
+};
+
+static QString decodeJsonString(const QByteArray& raw)
+{
+    if( !raw.contains('\\') )
+        return QString::fromUtf8(raw);
+    const QByteArray wrapped = "[\"" + raw + "\"]";
+    return QJsonDocument::fromJson(wrapped).array().at(0).toString();
+}
+
+void SyncJob::Private::streamData(const QByteArray& chunk)
+{
+    buffer.append(chunk);
+    for( ; scanPos < buffer.size(); ++scanPos )
+    {
+        const char c = buffer.at(scanPos);
+        if( inString )
+        {
+            if( escaped )
+                escaped = false;
+            else if( c == '\\' )
+                escaped = true;
+            else if( c == '"' )
+            {
+                inString = false;
+                continue;
+            }
+            // Strings inside rooms are of no interest for the scanner
+            if( !inRoom )
+                lastString.append(c);
+            continue;
+        }
+        switch( c )
+        {
+            case '"':
+                inString = true;
+                lastString.clear();
+                break;
+            case ':':
+                if( !inRoom && !keys.isEmpty() )
+                    keys.last() = lastString;
+                break;
+            case '{':
+            case '[':
+                if( !inRoom && c == '{' && isAtRoomLevel(nullptr) )
+                {
+                    // Flush everything before the room to the skeleton
+                    // and keep only the room in the buffer from now on
+                    skeleton.append(buffer.constData(), scanPos);
+                    buffer.remove(0, scanPos);
+                    scanPos = 0;
+                    inRoom = true;
+                }
+                keys.push_back(QByteArray());
+                break;
+            case '}':
+            case ']':
+                if( keys.isEmpty() )
+                {
+                    streamError = "Unbalanced JSON in the sync response";
+                    break;
+                }
+                keys.pop_back();
+                if( inRoom && isAtRoomLevel(nullptr) )
+                {
+                    finishRoom(buffer.left(scanPos + 1));
+                    // Keep the skeleton valid JSON without the room contents
+                    skeleton.append("null");
+                    buffer.remove(0, scanPos + 1);
+                    scanPos = -1; // Will be incremented by the loop
+                    inRoom = false;
+                }
+                break;
+        }
+    }
+    if( !inRoom )
+    {
+        skeleton.append(buffer);
+        buffer.clear();
+        scanPos = 0;
+    }
+}
+
+bool SyncJob::Private::isAtRoomLevel(JoinState* joinState) const
+{
+    // { "rooms": { "join": { "!roomid": { ... } } } }
+    if( keys.size() != 3 || keys[0] != "rooms" || keys[2].isEmpty() )
+        return false;
+
+    JoinState state;
+    if( keys[1] == "join" )
+        state = JoinState::Join;
+    else if( keys[1] == "invite" )
+        state = JoinState::Invite;
+    else if( keys[1] == "leave" )
+        state = JoinState::Leave;
+    else
+        return false;
+
+    if( joinState )
+        *joinState = state;
+    return true;
+}
+
+void SyncJob::Private::finishRoom(const QByteArray& roomJson)
+{
+    JoinState joinState;
+    isAtRoomLevel(&joinState);
+    QJsonParseError error;
+    QJsonDocument room = QJsonDocument::fromJson(roomJson, &error);
+    if( error.error != QJsonParseError::NoError )
+    {
+        streamError = error.errorString();
+        return;
+    }
+    roomData.push_back({decodeJsonString(keys[2]), room.object(), joinState});
+}
+
 SyncJob::SyncJob(ConnectionData* connection, QString since)
     : BaseJob(connection, JobHttpType::GetJob, "SyncJob")
     , d(new Private)
 {
+    setPriority(JobPriority::Sync);
     d->since = since;
     d->fullState = false;
     d->timeout = -1;
+    d->streaming = false;
+    d->scanPos = 0;
+    d->inString = false;
+    d->escaped = false;
+    d->inRoom = false;
 }
 
 SyncJob::~SyncJob()
@@ -75,6 +277,13 @@ void SyncJob::setPresence(QString presence)
 void SyncJob::setTimeout(int timeout)
 {
     d->timeout = timeout;
+    // Leave the server time to answer after the long poll has expired
+    setRequestTimeout(timeout >= 0 ? timeout + SyncTimeoutSlack : DefaultRequestTimeout);
+}
+
+void SyncJob::setStreaming(bool streaming)
+{
+    d->streaming = streaming;
 }
 
 QString SyncJob::nextBatch() const
@@ -108,10 +317,23 @@ QUrlQuery SyncJob::query() const
     return query;
 }
 
-void SyncJob::parseJson(const QJsonDocument& data)
+SyncJob::Private::Decoder::~Decoder()
+{
+    // Only left here if the job is gone
+    for( const SyncRoomData& room: roomData )
+    {
+        qDeleteAll(room.state);
+        qDeleteAll(room.timeline);
+        qDeleteAll(room.ephemeral);
+        qDeleteAll(room.accountData);
+        qDeleteAll(room.inviteState);
+    }
+}
+
+void SyncJob::Private::Decoder::decodeJson(const QJsonDocument& data)
 {
     QJsonObject json = data.object();
-    d->nextBatch = json.value("next_batch").toString();
+    nextBatch = json.value("next_batch").toString();
     // TODO: presence
     // TODO: account_data
     QJsonObject rooms = json.value("rooms").toObject();
@@ -122,16 +344,125 @@ void SyncJob::parseJson(const QJsonDocument& data)
         { "invite", JoinState::Invite },
         { "leave", JoinState::Leave }
     };
+    ParallelRoomDecoder decoder;
     for (auto roomState: roomStates)
     {
         const QJsonObject rs = rooms.value(roomState.jsonKey).toObject();
-        d->roomData.reserve(rs.size());
         for( auto r = rs.begin(); r != rs.end(); ++r )
         {
-            d->roomData.push_back({r.key(), r.value().toObject(), roomState.enumVal});
+            decoder.rooms.push_back({r.key(), r.value().toObject(), roomState.enumVal});
         }
     }
+    roomData.reserve(decoder.rooms.size());
+
+    const int threads = QThread::idealThreadCount();
+    if( decoder.rooms.size() < MinRoomsForParallelDecoding || threads < 2 )
+    {
+        for( const auto& r: decoder.rooms )
+            roomData.push_back({r.id, r.json, r.joinState});
+        return;
+    }
 
+    // Rooms are independent from each other, so spread them across
+    // the threads that are free right now, and decode in this thread too.
+    decoder.results.resize(decoder.rooms.size());
+    int helpers = 0;
+    for( ; helpers < threads - 1; ++helpers )
+    {
+        auto helper = new ParallelRoomDecoder::Helper(&decoder);
+        if( !QThreadPool::globalInstance()->tryStart(helper) )
+        {
+            delete helper;
+            break;
+        }
+    }
+    decoder.decodeRooms();
+    decoder.done.acquire(helpers);
+    for( SyncRoomData* room: decoder.results )
+    {
+        roomData.push_back(*room);
+        delete room;
+    }
+}
+
+BaseJob::Decoder* SyncJob::createDecoder() const
+{
+    return new Private::Decoder;
+}
+
+void SyncJob::parseJson(const QJsonDocument& data)
+{
+    auto decoder = static_cast<Private::Decoder*>(this->decoder());
+    d->nextBatch = decoder->nextBatch;
+    d->roomData.swap(decoder->roomData);
+    emitResult();
+}
+
+void SyncJob::gotPartialReply()
+{
+    if( !d->streaming )
+        return;
+    const int httpCode =
+        networkReply()->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if( httpCode != 200 )
+        return; // Leave error replies (e.g. retry_after_ms) to checkReply()
+
+    const int parsedRooms = d->roomData.size();
+    d->streamData(networkReply()->readAll());
+    // Only time out if the response stalls, not if it's just big
+    resetTimeout();
+    // Rooms announced with roomDataReady() can't be taken back, so
+    // the request must not be repeated after that, whatever the failure
+    // (including a timeout)
+    if( parsedRooms == 0 && !d->roomData.isEmpty() )
+        setMaxAttempts(1);
+    for( int i = parsedRooms; i < d->roomData.size(); ++i )
+        emit roomDataReady(d->roomData.at(i));
+}
+
+void SyncJob::beforeRetry()
+{
+    d->buffer.clear();
+    d->skeleton.clear();
+    d->keys.clear();
+    d->lastString.clear();
+    d->scanPos = 0;
+    d->inString = false;
+    d->escaped = false;
+    d->inRoom = false;
+    d->streamError.clear();
+}
+
+void SyncJob::gotReply()
+{
+    if( !d->streaming )
+    {
+        BaseJob::gotReply();
+        return;
+    }
+
+    if( !checkReply() )
+        return;
+    // Pick up whatever has arrived after the last readyRead()
+    gotPartialReply();
+
+    if( d->streamError.isEmpty() && (d->inString || !d->keys.isEmpty()) )
+        d->streamError = "Incomplete JSON in the sync response";
+    if( !d->streamError.isEmpty() )
+    {
+        fail( JsonParseError, d->streamError );
+        return;
+    }
+    // Rooms have already been parsed; the rest is small
+    QJsonParseError error;
+    QJsonDocument data = QJsonDocument::fromJson(d->skeleton, &error);
+    d->skeleton.clear();
+    if( error.error != QJsonParseError::NoError )
+    {
+        fail( JsonParseError, error.errorString() );
+        return;
+    }
+    d->nextBatch = data.object().value("next_batch").toString();
     emitResult();
 }
 
@@ -67,14 +67,39 @@ namespace QMatrixClient
             void setFullState(bool full);
             void setPresence(QString presence);
             void setTimeout(int timeout);
+            /**
+             * Makes the job parse the reply as it arrives instead of
+             * waiting for the whole document. Each room is parsed and
+             * announced with roomDataReady() as soon as its JSON object
+             * is complete; only the parts of the reply outside of room
+             * objects are buffered until the end. The request timeout
+             * restarts with every portion of data received, so a long
+             * response only times out if it stalls. Once a room has been
+             * announced, a failed or timed out request is not retried.
+             */
+            void setStreaming(bool streaming);
 
             QList<SyncRoomData> roomData() const;
             QString nextBatch() const;
 
+        signals:
+            /**
+             * Emitted in the streaming mode for each room, as soon as it
+             * has been received and parsed. The room is also available
+             * from roomData() afterwards.
+             */
+            void roomDataReady(const SyncRoomData& data);
+
         protected:
             QString apiPath() const override;
             QUrlQuery query() const override;
+            Decoder* createDecoder() const override;
             void parseJson(const QJsonDocument& data) override;
+            void beforeRetry() override;
+
+        protected slots:
+            void gotPartialReply() override;
+            void gotReply() override;
 
         private:
             class Private;
@@ -0,0 +1,70 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "jsonstorage.h"
+
+#include <QtCore/QJsonDocument>
+#include <QtCore/QDebug>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+#include <QtCore/QCborMap>
+#include <QtCore/QCborValue>
+#endif
+
+using namespace QMatrixClient;
+
+static const char JsonTextFormat = 'J';
+static const char CborFormat = 'C';
+
+QByteArray QMatrixClient::toStoredJson(const QJsonObject& object)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+    return CborFormat + QCborMap::fromJsonObject(object).toCborValue().toCbor();
+#else
+    return JsonTextFormat + QJsonDocument(object).toJson(QJsonDocument::Compact);
+#endif
+}
+
+QJsonObject QMatrixClient::fromStoredJson(const char* data, int size)
+{
+    if( size < 1 )
+        return QJsonObject();
+    switch( data[0] )
+    {
+        case JsonTextFormat:
+            return QJsonDocument::fromJson(QByteArray::fromRawData(data + 1, size - 1)).object();
+        case CborFormat:
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+            return QCborValue::fromCbor(data + 1, size - 1).toMap().toJsonObject();
+#else
+            qDebug() << "Can't read JSON stored as CBOR with Qt older than 5.12";
+            return QJsonObject();
+#endif
+        default:
+            return QJsonObject();
+    }
+}
+
+QJsonObject QMatrixClient::fromStoredJson(const QByteArray& data)
+{
+    return fromStoredJson(data.constData(), data.size());
+}
+
+bool QMatrixClient::isStoredJson(const char* data, int size)
+{
+    return size > 0 && (data[0] == JsonTextFormat || data[0] == CborFormat);
+}
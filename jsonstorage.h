@@ -0,0 +1,47 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_JSONSTORAGE_H
+#define QMATRIXCLIENT_JSONSTORAGE_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QJsonObject>
+
+namespace QMatrixClient
+{
+    /**
+     * Serializes JSON objects for the files the library keeps on disk.
+     *
+     * The data starts with a format byte: CBOR follows if Qt supports it
+     * (5.12 and newer), compact JSON text otherwise. Both are read back
+     * by any later Qt version; only CBOR written by a newer Qt can't be
+     * read by a Qt older than 5.12.
+     */
+    QByteArray toStoredJson(const QJsonObject& object);
+    /**
+     * Reads what toStoredJson() has written, from size bytes at data.
+     * Returns an empty object if the data is damaged or in an unknown
+     * format.
+     */
+    QJsonObject fromStoredJson(const char* data, int size);
+    QJsonObject fromStoredJson(const QByteArray& data);
+    /** Whether the data starts with a format byte toStoredJson() writes */
+    bool isStoredJson(const char* data, int size);
+}
+
+#endif // QMATRIXCLIENT_JSONSTORAGE_H
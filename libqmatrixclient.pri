@@ -11,7 +11,14 @@ HEADERS += \
     $$PWD/user.h \
     $$PWD/logmessage.h \
     $$PWD/state.h \
+    $$PWD/jsonstorage.h \
+    $$PWD/identifierpool.h \
+    $$PWD/eventlog.h \
+    $$PWD/filter.h \
+    $$PWD/timerwheel.h \
+    $$PWD/mediacache.h \
     $$PWD/events/event.h \
+    $$PWD/events/eventpool.h \
     $$PWD/events/roommessageevent.h \
     $$PWD/events/roomnameevent.h \
     $$PWD/events/roomaliasesevent.h \
@@ -22,6 +29,7 @@ HEADERS += \
     $$PWD/events/receiptevent.h \
     $$PWD/events/unknownevent.h \
     $$PWD/jobs/basejob.h \
+    $$PWD/jobs/jobscheduler.h \
     $$PWD/jobs/checkauthmethods.h \
     $$PWD/jobs/passwordlogin.h \
     $$PWD/jobs/postmessagejob.h \
@@ -31,7 +39,10 @@ HEADERS += \
     $$PWD/jobs/roommembersjob.h \
     $$PWD/jobs/roommessagesjob.h \
     $$PWD/jobs/syncjob.h \
+    $$PWD/jobs/definefilterjob.h \
     $$PWD/jobs/mediathumbnailjob.h \
+    $$PWD/jobs/mediadownloadjob.h \
+    $$PWD/jobs/mediauploadjob.h \
     $$PWD/kcoreaddons/src/lib/jobs/kjob.h \
     $$PWD/kcoreaddons/src/lib/jobs/kcompositejob.h \
     $$PWD/kcoreaddons/src/lib/jobs/kjobtrackerinterface.h \
@@ -45,7 +56,14 @@ SOURCES += \
     $$PWD/user.cpp \
     $$PWD/logmessage.cpp \
     $$PWD/state.cpp \
+    $$PWD/jsonstorage.cpp \
+    $$PWD/identifierpool.cpp \
+    $$PWD/eventlog.cpp \
+    $$PWD/filter.cpp \
+    $$PWD/timerwheel.cpp \
+    $$PWD/mediacache.cpp \
     $$PWD/events/event.cpp \
+    $$PWD/events/eventpool.cpp \
     $$PWD/events/roommessageevent.cpp \
     $$PWD/events/roomnameevent.cpp \
     $$PWD/events/roomaliasesevent.cpp \
@@ -56,6 +74,7 @@ SOURCES += \
     $$PWD/events/receiptevent.cpp \
     $$PWD/events/unknownevent.cpp \
     $$PWD/jobs/basejob.cpp \
+    $$PWD/jobs/jobscheduler.cpp \
     $$PWD/jobs/checkauthmethods.cpp \
     $$PWD/jobs/passwordlogin.cpp \
     $$PWD/jobs/postmessagejob.cpp \
@@ -65,7 +84,10 @@ SOURCES += \
     $$PWD/jobs/roommembersjob.cpp \
     $$PWD/jobs/roommessagesjob.cpp \
     $$PWD/jobs/syncjob.cpp \
+    $$PWD/jobs/definefilterjob.cpp \
     $$PWD/jobs/mediathumbnailjob.cpp \
+    $$PWD/jobs/mediadownloadjob.cpp \
+    $$PWD/jobs/mediauploadjob.cpp \
     $$PWD/kcoreaddons/src/lib/jobs/kjob.cpp \
     $$PWD/kcoreaddons/src/lib/jobs/kcompositejob.cpp \
     $$PWD/kcoreaddons/src/lib/jobs/kjobtrackerinterface.cpp \
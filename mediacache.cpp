@@ -0,0 +1,217 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "mediacache.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
+#include <QtCore/QDebug>
+
+using namespace QMatrixClient;
+
+class MediaCache::Private
+{
+    public:
+        struct Item
+        {
+            qint64 size;
+            quint64 lastUse;
+        };
+
+        QMutex mutex;
+        QDir dir;
+        bool loaded;
+        qint64 maxSize;
+        qint64 size;
+        quint64 useCounter;
+        QHash<QString, Item> items; // By file name
+        QMap<quint64, QString> lru; // Last use -> file name, oldest first
+
+        static QString fileName(const QString& key);
+        /** Indexes the files already in the directory on first use */
+        void load();
+        void touch(const QString& name);
+        void removeItem(const QString& name);
+        void shrink();
+};
+
+QString MediaCache::Private::fileName(const QString& key)
+{
+    return QString::fromLatin1(
+        QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+void MediaCache::Private::load()
+{
+    if( loaded )
+        return;
+    loaded = true;
+    dir.mkpath(".");
+    const QFileInfoList files =
+        dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    for( const QFileInfo& file: files )
+    {
+        items.insert(file.fileName(), { file.size(), ++useCounter });
+        lru.insert(useCounter, file.fileName());
+        size += file.size();
+    }
+    shrink();
+}
+
+void MediaCache::Private::touch(const QString& name)
+{
+    Item& item = items[name];
+    lru.remove(item.lastUse);
+    item.lastUse = ++useCounter;
+    lru.insert(item.lastUse, name);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    QFile file(dir.filePath(name));
+    if( file.open(QIODevice::ReadWrite) )
+        file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+#endif
+}
+
+void MediaCache::Private::removeItem(const QString& name)
+{
+    const Item item = items.take(name);
+    lru.remove(item.lastUse);
+    size -= item.size;
+    dir.remove(name);
+}
+
+void MediaCache::Private::shrink()
+{
+    while( size > maxSize && !lru.isEmpty() )
+        removeItem(lru.first());
+}
+
+MediaCache::MediaCache(const QString& dirPath)
+    : d(new Private)
+{
+    d->dir.setPath(dirPath);
+    d->loaded = false;
+    d->maxSize = 100 * 1024 * 1024;
+    d->size = 0;
+    d->useCounter = 0;
+}
+
+MediaCache::~MediaCache()
+{
+    delete d;
+}
+
+MediaCache* MediaCache::forDirectory(const QString& dirPath)
+{
+    static QMutex cachesMutex;
+    static struct Caches: QHash<QString, MediaCache*>
+    {
+        ~Caches() { qDeleteAll(*this); }
+    } caches;
+
+    const QString path = QDir::cleanPath(QDir(dirPath).absolutePath());
+    QMutexLocker locker(&cachesMutex);
+    MediaCache*& cache = caches[path];
+    if( !cache )
+        cache = new MediaCache(path);
+    return cache;
+}
+
+QString MediaCache::thumbnailKey(const QUrl& url, int width, int height, const QString& method)
+{
+    return QString("%1 %2x%3 %4").arg(url.toString()).arg(width).arg(height).arg(method);
+}
+
+QByteArray MediaCache::find(const QString& key)
+{
+    QMutexLocker locker(&d->mutex);
+    d->load();
+    const QString name = Private::fileName(key);
+    if( !d->items.contains(name) )
+        return QByteArray();
+
+    QFile file(d->dir.filePath(name));
+    if( !file.open(QIODevice::ReadOnly) )
+    {
+        // Removed behind our back
+        d->removeItem(name);
+        return QByteArray();
+    }
+    d->touch(name);
+    return file.readAll();
+}
+
+void MediaCache::insert(const QString& key, const QByteArray& data)
+{
+    QMutexLocker locker(&d->mutex);
+    d->load();
+    if( data.size() > d->maxSize )
+        return;
+
+    const QString name = Private::fileName(key);
+    QSaveFile file(d->dir.filePath(name));
+    if( !file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit() )
+    {
+        qDebug() << "MediaCache: can't write" << file.fileName() << ":" << file.errorString();
+        return;
+    }
+    if( d->items.contains(name) )
+    {
+        d->size -= d->items.value(name).size;
+        d->lru.remove(d->items.value(name).lastUse);
+    }
+    d->items.insert(name, { data.size(), ++d->useCounter });
+    d->lru.insert(d->useCounter, name);
+    d->size += data.size();
+    d->shrink();
+}
+
+void MediaCache::remove(const QString& key)
+{
+    QMutexLocker locker(&d->mutex);
+    d->load();
+    const QString name = Private::fileName(key);
+    if( d->items.contains(name) )
+        d->removeItem(name);
+}
+
+void MediaCache::setMaxSize(qint64 bytes)
+{
+    QMutexLocker locker(&d->mutex);
+    d->maxSize = bytes;
+    if( d->loaded )
+        d->shrink();
+}
+
+qint64 MediaCache::maxSize() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->maxSize;
+}
+
+qint64 MediaCache::size() const
+{
+    QMutexLocker locker(&d->mutex);
+    d->load();
+    return d->size;
+}
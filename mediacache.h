@@ -0,0 +1,76 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_MEDIACACHE_H
+#define QMATRIXCLIENT_MEDIACACHE_H
+
+#include <QtCore/QString>
+#include <QtCore/QByteArray>
+#include <QtCore/QUrl>
+
+namespace QMatrixClient
+{
+    /**
+     * A disk cache of downloaded media (thumbnails, avatars).
+     *
+     * Each item is a file named after the hash of its key in the cache
+     * directory. When the total size goes over the budget, the least
+     * recently used items are removed. The recency of items is kept in
+     * memory and in the modification times of the files, so the order
+     * survives restarts (with Qt 5.10 or newer; with older Qt versions
+     * reads don't count as uses across restarts).
+     *
+     * There is one instance per directory, shared by all connections
+     * using it (see forDirectory()), so that they keep one size total and
+     * one LRU order. It is thread-safe; since find() and insert() do file
+     * I/O (and the first call indexes the directory), jobs call them on
+     * worker threads.
+     */
+    class MediaCache
+    {
+        public:
+            /**
+             * The cache for the directory, created on first request and
+             * kept until the application exits
+             */
+            static MediaCache* forDirectory(const QString& dirPath);
+
+            /** A cache key for a thumbnail of the mxc:// URL */
+            static QString thumbnailKey(const QUrl& url, int width, int height,
+                                        const QString& method);
+
+            /** Returns the cached data, or an empty array if there's none */
+            QByteArray find(const QString& key);
+            void insert(const QString& key, const QByteArray& data);
+            void remove(const QString& key);
+
+            /** The byte budget of the cache; 100 MiB by default */
+            void setMaxSize(qint64 bytes);
+            qint64 maxSize() const;
+            qint64 size() const;
+
+        private:
+            explicit MediaCache(const QString& dirPath);
+            ~MediaCache();
+
+            class Private;
+            Private* d;
+    };
+}
+
+#endif // QMATRIXCLIENT_MEDIACACHE_H
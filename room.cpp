@@ -23,6 +23,9 @@
 #include <QtCore/QHash>
 #include <QtCore/QJsonArray>
 #include <QtCore/QStringBuilder> // for efficient string concats (operator%)
+#include <QtCore/QDir>
+#include <QtCore/QUrl>
+#include <QtCore/QTimer>
 #include <QtCore/QDebug>
 
 #include "connection.h"
@@ -38,6 +41,7 @@
 #include "events/typingevent.h"
 #include "events/receiptevent.h"
 #include "jobs/roommessagesjob.h"
+#include "eventlog.h"
 
 using namespace QMatrixClient;
 
@@ -46,6 +50,8 @@ class Room::Private: public QObject
     public:
         /** Map of user names to users. User names potentially duplicate, hence a multi-hashmap. */
         typedef QMultiHash<QString, User*> members_map_t;
+        /** (type, state_key) of a state event */
+        typedef QPair<QString, QString> state_key_t;
         
         Private(Room* parent): q(parent) {}
 
@@ -72,8 +78,19 @@ class Room::Private: public QObject
         QList<User*> usersTyping;
         QList<User*> membersLeft;
         QHash<User*, QString> lastReadEvent;
+        /** The latest state events, kept to save the room to the state cache */
+        QHash<state_key_t, QJsonObject> currentState;
         QString prevBatch;
         RoomMessagesJob* roomMessagesJob;
+        EventLog* eventLog;
+        bool eventLogChecked;
+        /** Eviction doesn't touch this event and the newer ones */
+        Event* pinnedEvent;
+        /** The newest event marked as read that hasn't been posted yet */
+        Event* pendingReceipt;
+        /** The latest event in the timeline we have posted a receipt for */
+        QString lastReceiptEventId;
+        QTimer* receiptTimer;
         
         // Convenience methods to work with the membersMap and usersLeft. addMember()
         // and removeMember() emit respective Room:: signals after a succesful
@@ -87,6 +104,20 @@ class Room::Private: public QObject
         void removeMember(User* u);
 
         void getPreviousContent();
+        /** Loads events older than the oldest one in memory from the event log */
+        bool getPreviousContentFromLog();
+        /** Opens the event log on first use if the connection has it enabled */
+        EventLog* log();
+        /** Drops the oldest events beyond Connection::maxResidentEvents() */
+        void evictOldEvents();
+        void postPendingReceipt();
+        /** Accounts for a receipt of ours that came from another device */
+        void updateLastReceipt(const QString& eventId);
+        /**
+         * The position of the event in messageEvents, or -1 if it's not
+         * there (e.g. because it has been evicted as one of the oldest)
+         */
+        int timelinePosition(const QString& eventId) const;
 
     private:
         QString calculateDisplayname() const;
@@ -96,6 +127,9 @@ class Room::Private: public QObject
         void removeMemberFromMap(QString username, User* u);
 };
 
+/** Receipts are posted at most once per this interval, in ms */
+static const int ReceiptInterval = 1000;
+
 Room::Room(Connection* connection, QString id)
     : QObject(connection), d(new Private(this))
 {
@@ -103,6 +137,14 @@ Room::Room(Connection* connection, QString id)
     d->connection = connection;
     d->joinState = JoinState::Join;
     d->roomMessagesJob = nullptr;
+    d->eventLog = nullptr;
+    d->eventLogChecked = false;
+    d->pinnedEvent = nullptr;
+    d->pendingReceipt = nullptr;
+    d->receiptTimer = new QTimer(this);
+    d->receiptTimer->setSingleShot(true);
+    d->receiptTimer->setInterval(ReceiptInterval);
+    connect( d->receiptTimer, &QTimer::timeout, [=] () { d->postPendingReceipt(); } );
     qDebug() << "New Room:" << id;
 
     //connection->getMembers(this); // I don't think we need this anymore in r0.0.1
@@ -111,6 +153,7 @@ Room::Room(Connection* connection, QString id)
 Room::~Room()
 {
     qDebug() << "deconstructing room" << this;
+    delete d->eventLog;
     delete d;
 }
 
@@ -165,7 +208,46 @@ void Room::setJoinState(JoinState state)
 
 void Room::markMessageAsRead(Event* event)
 {
-    d->connection->postReceipt(this, event);
+    // Receipts that don't move the read position forward are useless.
+    // Timestamps come from the clocks of different servers, so compare
+    // positions in the timeline instead.
+    const int position = d->messageEvents.lastIndexOf(event);
+    if( position < 0 || position <= d->timelinePosition(d->lastReceiptEventId) ||
+        (d->pendingReceipt && position <= d->messageEvents.lastIndexOf(d->pendingReceipt)) )
+        return;
+
+    d->pendingReceipt = event;
+    if( !d->receiptTimer->isActive() )
+        d->receiptTimer->start();
+}
+
+int Room::Private::timelinePosition(const QString& eventId) const
+{
+    if( eventId.isEmpty() )
+        return -1;
+    // Receipts usually come for recent events, so look from the end
+    for( int i = messageEvents.size() - 1; i >= 0; --i )
+    {
+        if( messageEvents.at(i)->id() == eventId )
+            return i;
+    }
+    return -1;
+}
+
+void Room::Private::updateLastReceipt(const QString& eventId)
+{
+    const int position = timelinePosition(eventId);
+    if( position >= 0 && position > timelinePosition(lastReceiptEventId) )
+        lastReceiptEventId = eventId;
+}
+
+void Room::Private::postPendingReceipt()
+{
+    if( !pendingReceipt )
+        return;
+    connection->postReceipt(q, pendingReceipt);
+    lastReceiptEventId = pendingReceipt->id();
+    pendingReceipt = nullptr;
 }
 
 QString Room::lastReadEvent(User* user)
@@ -199,6 +281,42 @@ if( d->highlightCount == 0 )
     emit highlightCountChanged(this);
 }
 
+QJsonObject Room::toJson(int timelineLimit) const
+{
+    QJsonArray stateEvents;
+    for( const QJsonObject& stateEvent: d->currentState )
+        stateEvents.append(stateEvent);
+
+    QJsonArray timelineEvents;
+    const int timelineStart = qMax(0, d->messageEvents.size() - timelineLimit);
+    for( int i = timelineStart; i < d->messageEvents.size(); ++i )
+    {
+        const QJsonObject json = d->messageEvents.at(i)->originalJsonObject();
+        if( !json.isEmpty() )
+            timelineEvents.append(json);
+    }
+
+    QJsonObject state;
+    state.insert("events", stateEvents);
+    QJsonObject result;
+    if( d->joinState == JoinState::Invite )
+    {
+        result.insert("invite_state", state);
+        return result;
+    }
+    result.insert("state", state);
+    QJsonObject timeline;
+    timeline.insert("events", timelineEvents);
+    timeline.insert("limited", true);
+    timeline.insert("prev_batch", d->prevBatch);
+    result.insert("timeline", timeline);
+    QJsonObject unreadNotifications;
+    unreadNotifications.insert("highlight_count", d->highlightCount);
+    unreadNotifications.insert("notification_count", d->notificationCount);
+    result.insert("unread_notifications", unreadNotifications);
+    return result;
+}
+
 QList< User* > Room::usersTyping() const
 {
     return d->usersTyping;
@@ -371,6 +489,11 @@ void Room::updateData(const SyncRoomData& data)
         d->notificationCount = data.notificationCount;
         emit notificationCountChanged(this);
     }
+    if( d->eventLog )
+    {
+        d->eventLog->flush();
+        d->evictOldEvents();
+    }
 }
 
 void Room::getPreviousContent()
@@ -380,22 +503,113 @@ void Room::getPreviousContent()
 
 void Room::Private::getPreviousContent()
 {
-    if( !roomMessagesJob )
-    {
-        roomMessagesJob = connection->getMessages(q, prevBatch);
-        connect( roomMessagesJob, &RoomMessagesJob::result, [=]() {
-            if( !roomMessagesJob->error() )
+    if( roomMessagesJob || getPreviousContentFromLog() )
+        return;
+
+    roomMessagesJob = connection->getMessages(q, prevBatch);
+    connect( roomMessagesJob, &RoomMessagesJob::result, [=]() {
+        RoomMessagesJob* job = roomMessagesJob;
+        roomMessagesJob = nullptr;
+        if( job->error() )
+            return;
+
+        // prevBatch may point further back than the history already
+        // served from the event log; skip what we have already seen.
+        bool gotNewEvents = false;
+        for( Event* event: job->events() )
+        {
+            if( eventLog && eventLog->contains(event->id()) )
             {
-                for( Event* event: roomMessagesJob->events() )
-                {
-                    q->processMessageEvent(event);
-                    emit q->newMessage(event);
-                }
-                prevBatch = roomMessagesJob->end();
+                delete event;
+                continue;
             }
-            roomMessagesJob = nullptr;
-        });
+            q->processMessageEvent(event);
+            emit q->newMessage(event);
+            gotNewEvents = true;
+        }
+        const bool movedBack = prevBatch != job->end() && !job->events().isEmpty();
+        prevBatch = job->end();
+        if( eventLog )
+            eventLog->flush();
+        if( !gotNewEvents && movedBack )
+            getPreviousContent();
+    });
+}
+
+bool Room::Private::getPreviousContentFromLog()
+{
+    EventLog* eventLog = log();
+    if( !eventLog || messageEvents.isEmpty() )
+        return false;
+
+    // Keyed on the id as well, so that evicted events of the same
+    // millisecond as the oldest resident one are found too
+    const Event* oldest = messageEvents.first();
+    const QList<QJsonObject> events = eventLog->eventsBefore(
+        oldest->timestamp().toMSecsSinceEpoch(), oldest->id(), 10);
+    if( events.isEmpty() )
+        return false;
+    for( const QJsonObject& json: events )
+    {
+        Event* event = Event::fromJson(json);
+        q->processMessageEvent(event);
+        emit q->newMessage(event);
+    }
+    return true;
+}
+
+void Room::Private::evictOldEvents()
+{
+    const int maxEvents = connection->maxResidentEvents();
+    if( !eventLog || maxEvents <= 0 || messageEvents.size() <= maxEvents )
+        return;
+
+    int evictCount = messageEvents.size() - maxEvents;
+    if( pinnedEvent )
+    {
+        const int pinnedPos = messageEvents.indexOf(pinnedEvent);
+        if( pinnedPos >= 0 )
+            evictCount = qMin(evictCount, pinnedPos);
+    }
+    if( evictCount <= 0 )
+        return;
+
+    eventLog->flush();
+    const QList<Event*> evicted = messageEvents.mid(0, evictCount);
+    if( evicted.contains(pendingReceipt) )
+        postPendingReceipt();
+    emit q->aboutToEvictEvents(evicted);
+    messageEvents.erase(messageEvents.begin(), messageEvents.begin() + evicted.size());
+    qDeleteAll(evicted);
+}
+
+void Room::setPinnedEvent(Event* event)
+{
+    d->pinnedEvent = event;
+}
+
+Event* Room::pinnedEvent() const
+{
+    return d->pinnedEvent;
+}
+
+EventLog* Room::Private::log()
+{
+    if( eventLogChecked )
+        return eventLog;
+    eventLogChecked = true;
+    if( !connection->eventLogEnabled() )
+        return nullptr;
+
+    const QString dirPath = connection->stateCachePath() + "rooms/";
+    QDir().mkpath(dirPath);
+    eventLog = new EventLog(dirPath + QString::fromLatin1(QUrl::toPercentEncoding(id)));
+    if( !eventLog->open() )
+    {
+        delete eventLog;
+        eventLog = nullptr;
     }
+    return eventLog;
 }
 
 Connection* Room::connection()
@@ -406,10 +620,20 @@ Connection* Room::connection()
 void Room::processMessageEvent(Event* event)
 {
     d->messageEvents.insert(findInsertionPos(d->messageEvents, event), event);
+    if( EventLog* eventLog = d->log() )
+        eventLog->append(event->originalJsonObject());
 }
 
 void Room::processStateEvent(Event* event)
 {
+    const QJsonObject json = event->originalJsonObject();
+    if( json.contains("state_key") )
+    {
+        d->currentState.insert(
+            qMakePair(json.value("type").toString(), json.value("state_key").toString()),
+            json);
+    }
+
     if( event->type() == EventType::RoomName )
     {
         if (RoomNameEvent* nameEvent = static_cast<RoomNameEvent*>(event))
@@ -483,6 +707,8 @@ void Room::processEphemeralEvent(Event* event)
             for( Receipt r: receipts )
             {
                 d->lastReadEvent.insert(d->connection->user(r.userId), eventId);
+                if( r.userId == d->connection->userId() )
+                    d->updateLastReceipt(eventId);
             }
         }
     }
@@ -64,7 +64,24 @@ namespace QMatrixClient
             Q_INVOKABLE void updateData( const SyncRoomData& data );
             Q_INVOKABLE void setJoinState( JoinState state );
 
+            /**
+             * Posts a read receipt for the event. Receipts are sent at
+             * most once a second per room, for the newest event marked
+             * in that time; events that are not later in the timeline
+             * than the one last acknowledged are ignored.
+             */
             Q_INVOKABLE void markMessageAsRead( Event* event );
+
+            /**
+             * Keeps the event and all newer ones in memory regardless of
+             * Connection::maxResidentEvents(). Nothing is pinned by the
+             * library itself: the UI should pin the oldest event it shows
+             * while the user is scrolled back, and pass nullptr to unpin
+             * once it is back at the bottom of the timeline, so that the
+             * room can keep to the limit again.
+             */
+            Q_INVOKABLE void setPinnedEvent( Event* event );
+            Q_INVOKABLE Event* pinnedEvent() const;
             Q_INVOKABLE QString lastReadEvent(User* user);
 
             Q_INVOKABLE int notificationCount() const;
@@ -72,6 +89,14 @@ namespace QMatrixClient
             Q_INVOKABLE int highlightCount() const;
             Q_INVOKABLE void resetHighlightCount();
 
+            /**
+             * Produces the room in the form of a room entry in a /sync
+             * response: the current state, the last timelineLimit events
+             * of the timeline and the unread counters. This is what
+             * Connection::saveState() stores for each room.
+             */
+            QJsonObject toJson(int timelineLimit) const;
+
         public slots:
             void getPreviousContent();
             void userRenamed(User* user, QString oldName);
@@ -93,6 +118,12 @@ namespace QMatrixClient
             void typingChanged();
             void highlightCountChanged(Room* room);
             void notificationCountChanged(Room* room);
+            /**
+             * Triggered before the oldest events are dropped from memory
+             * (see Connection::setMaxResidentEvents()); the events are
+             * deleted right after it returns.
+             */
+            void aboutToEvictEvents(QList<Event*> events);
 
         protected:
             Connection* connection();
@@ -0,0 +1,205 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "timerwheel.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QTimer>
+
+using namespace QMatrixClient;
+
+static const int InnerSlots = 256;
+static const int OuterSlots = 64;
+// Leaves a spare outer slot for the ticks the wheel may lag behind the clock
+static const quint64 MaxTicks = InnerSlots * (OuterSlots - 1);
+
+class TimerWheel::Private
+{
+    public:
+        struct Entry
+        {
+            quint64 expiry; // In ticks
+            std::function<void()> callback;
+            QList<TimerId>* slot;
+        };
+
+        int tickMsec;
+        QTimer timer;
+        QElapsedTimer clock;
+        quint64 currentTick;
+        /** The tick the timer goes off at, while there are timeouts */
+        quint64 armedTick;
+        /** Set while tick() runs the due callbacks */
+        bool ticking;
+        TimerId lastId;
+        QHash<TimerId, Entry> entries;
+        QList<TimerId> inner[InnerSlots];
+        QList<TimerId> outer[OuterSlots];
+
+        quint64 ticksElapsed() const { return quint64(clock.elapsed()) / tickMsec; }
+        void place(TimerId id, Entry& entry);
+        /** The first tick after currentTick that has timeouts due or to cascade */
+        quint64 nextBusyTick() const;
+        /** Sets the timer to go off at nextBusyTick(), or stops it if nothing is pending */
+        void arm();
+};
+
+void TimerWheel::Private::place(TimerId id, Entry& entry)
+{
+    if( entry.expiry - currentTick < InnerSlots )
+        entry.slot = &inner[entry.expiry % InnerSlots];
+    else
+        entry.slot = &outer[(entry.expiry / InnerSlots) % OuterSlots];
+    entry.slot->append(id);
+}
+
+quint64 TimerWheel::Private::nextBusyTick() const
+{
+    // Outer slots are only looked at when they are cascaded, at the
+    // first tick of their round
+    const quint64 round = currentTick / InnerSlots;
+    quint64 next = (round + OuterSlots) * InnerSlots;
+    for( quint64 r = round + 1; r < round + OuterSlots; ++r )
+    {
+        if( !outer[r % OuterSlots].isEmpty() )
+        {
+            next = r * InnerSlots;
+            break;
+        }
+    }
+    for( quint64 t = currentTick + 1; t < currentTick + InnerSlots && t < next; ++t )
+    {
+        if( !inner[t % InnerSlots].isEmpty() )
+            return t;
+    }
+    return next;
+}
+
+void TimerWheel::Private::arm()
+{
+    if( entries.isEmpty() )
+    {
+        timer.stop();
+        return;
+    }
+    armedTick = nextBusyTick();
+    const qint64 delay = qint64(armedTick) * tickMsec - clock.elapsed();
+    timer.start(int(qBound<qint64>(0, delay, MaxTicks * tickMsec)));
+}
+
+TimerWheel::TimerWheel(int tickMsec, QObject* parent)
+    : QObject(parent)
+    , d(new Private)
+{
+    d->tickMsec = tickMsec;
+    d->currentTick = 0;
+    d->armedTick = 0;
+    d->ticking = false;
+    d->lastId = 0;
+    d->clock.start();
+    d->timer.setSingleShot(true);
+    // So that the timer follows the wheel in moveToThread(); d is
+    // deleted before QObject would try to delete its children
+    d->timer.setParent(this);
+    connect( &d->timer, &QTimer::timeout, this, &TimerWheel::tick );
+}
+
+TimerWheel::~TimerWheel()
+{
+    delete d;
+}
+
+TimerWheel::TimerId TimerWheel::start(int msec, std::function<void()> callback)
+{
+    if( d->entries.isEmpty() )
+        d->currentTick = d->ticksElapsed(); // Nothing is pending, jump to the present
+    else if( !d->ticking )
+    {
+        // Nothing happens before the armed tick, so the wheel can skip
+        // the ticks up to it without looking at them
+        d->currentTick = qMax(d->currentTick, qMin(d->ticksElapsed(), d->armedTick - 1));
+    }
+    const quint64 ticks = qBound<quint64>(1, (qMax(msec, 0) + d->tickMsec - 1) / d->tickMsec, MaxTicks);
+    const quint64 expiry = qMax(d->currentTick, d->ticksElapsed()) + ticks;
+    const TimerId id = ++d->lastId;
+    Private::Entry& entry = d->entries.insert(id, { expiry, callback, nullptr }).value();
+    d->place(id, entry);
+    if( !d->ticking )
+        d->arm();
+    return id;
+}
+
+void TimerWheel::cancel(TimerId id)
+{
+    auto it = d->entries.find(id);
+    if( it == d->entries.end() )
+        return;
+    it->slot->removeOne(id);
+    d->entries.erase(it);
+    if( !d->ticking )
+        d->arm();
+}
+
+int TimerWheel::pendingTimers() const
+{
+    return d->entries.size();
+}
+
+void TimerWheel::tick()
+{
+    d->ticking = true;
+    // Go through the ticks since the last one, up to the present;
+    // the timer only went off because one of them has something to do
+    const quint64 targetTick = d->ticksElapsed();
+    while( d->currentTick < targetTick && !d->entries.isEmpty() )
+    {
+        ++d->currentTick;
+        if( d->currentTick % InnerSlots == 0 )
+        {
+            QList<TimerId> cascaded;
+            cascaded.swap(d->outer[(d->currentTick / InnerSlots) % OuterSlots]);
+            for( TimerId id: cascaded )
+            {
+                auto it = d->entries.find(id);
+                if( it != d->entries.end() )
+                    d->place(id, *it);
+            }
+        }
+
+        QList<TimerId> due;
+        due.swap(d->inner[d->currentTick % InnerSlots]);
+        for( TimerId id: due )
+        {
+            auto it = d->entries.find(id);
+            if( it == d->entries.end() )
+                continue;
+            if( it->expiry > d->currentTick )
+            {
+                d->place(id, *it);
+                continue;
+            }
+            std::function<void()> callback = it->callback;
+            cancel(id);
+            callback(); // May start or cancel other timeouts
+        }
+    }
+    d->ticking = false;
+    d->arm();
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Copyright (C) 2026 libqmatrixclient contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef QMATRIXCLIENT_TIMERWHEEL_H
+#define QMATRIXCLIENT_TIMERWHEEL_H
+
+#include <QtCore/QObject>
+
+#include <functional>
+
+namespace QMatrixClient
+{
+    /**
+     * Runs any number of one-shot timeouts off a single QTimer.
+     *
+     * Timeouts are rounded up to whole ticks and kept in a two-level
+     * hierarchical wheel: the inner level has a slot per tick for the
+     * next 256 ticks, the outer one a slot per 256 ticks; outer slots
+     * are moved to the inner level as their time comes. Starting and
+     * cancelling a timeout take constant time. The longest timeout is
+     * 256 * 63 ticks (about 67 minutes with the default 250 ms tick);
+     * longer ones are cut down to it.
+     *
+     * The QTimer doesn't tick all the time: it is set to go off at the
+     * next tick that has timeouts due (or outer slots to cascade), so an
+     * idle wheel with a few long timeouts wakes up about as often as
+     * separate single-shot timers would.
+     */
+    class TimerWheel: public QObject
+    {
+            Q_OBJECT
+        public:
+            typedef quint64 TimerId;
+
+            explicit TimerWheel(int tickMsec = 250, QObject* parent = nullptr);
+            virtual ~TimerWheel();
+
+            /**
+             * Calls callback once, msec milliseconds from now with the
+             * precision of one tick. Returns an id for cancel(); ids are
+             * never 0.
+             */
+            TimerId start(int msec, std::function<void()> callback);
+            /** Makes sure the callback won't be called; does nothing for unknown ids */
+            void cancel(TimerId id);
+            int pendingTimers() const;
+
+        private slots:
+            void tick();
+
+        private:
+            class Private;
+            Private* d;
+    };
+}
+
+#endif // QMATRIXCLIENT_TIMERWHEEL_H
@@ -23,11 +23,32 @@
 #include "events/roommemberevent.h"
 #include "jobs/mediathumbnailjob.h"
 
-#include <QtCore/QTimer>
-#include <QtCore/QPair>
+#include <QtCore/QCache>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtGui/QPixmap>
 
 using namespace QMatrixClient;
 
+namespace
+{
+    /**
+     * Avatars of all users, by avatarKey(), costed in pixels. Only used
+     * in the GUI thread, as pixmaps are.
+     */
+    QCache<QString, QPixmap>& avatarCache()
+    {
+        static QCache<QString, QPixmap> cache(4 * 1024 * 1024);
+        return cache;
+    }
+
+    QString avatarKey(const QUrl& url, const QSize& size)
+    {
+        return QString("%1 %2x%3").arg(url.toString())
+                                  .arg(size.width()).arg(size.height());
+    }
+}
+
 class User::Private
 {
     public:
@@ -37,12 +58,20 @@ class User::Private
         QUrl avatarUrl;
         Connection* connection;
 
-        QPixmap avatar;
-        int requestedWidth;
-        int requestedHeight;
-        bool avatarValid;
-        bool avatarOngoingRequest;
-        QHash<QPair<int,int>,QPixmap> scaledMap;
+        /**
+         * Guards the avatar fields: avatar() is called in the GUI thread,
+         * while the connection may work in a thread of its own (see
+         * Connection::moveToWorkerThread())
+         */
+        QMutex avatarMutex;
+        /** Sizes for avatar() to request, in requestAvatar() */
+        QList<QSize> pendingSizes;
+        /** Sizes requested and not downloaded yet */
+        QSet<QPair<int, int>> ongoingSizes;
+        /** Images from the thumbnail jobs, for avatar() to cache */
+        QHash<QString, QImage> readyImages;
+        /** The latest avatar made by avatar(), for sizes not there yet */
+        QPixmap lastAvatar;
 
         void requestAvatar();
 };
@@ -53,8 +82,6 @@ User::User(QString userId, Connection* connection)
     d->q = this;
     d->connection = connection;
     d->userId = userId;
-    d->avatarValid = false;
-    d->avatarOngoingRequest = false;
 }
 
 User::~User()
@@ -81,28 +108,47 @@ QString User::displayname() const
 
 QPixmap User::avatar(int width, int height)
 {
-    if( !d->avatarValid
-        || width > d->requestedWidth
-        || height > d->requestedHeight )
+    const QSize size(width, height);
+    QString key;
+    QImage image;
     {
-        if( !d->avatarOngoingRequest && d->avatarUrl.isValid() )
-        {
-            qDebug() << "Getting avatar for" << id();
-            d->requestedWidth = width;
-            d->requestedHeight = height;
-            d->avatarOngoingRequest = true;
-            QTimer::singleShot(0, this, SLOT(requestAvatar()));
-        }
+        QMutexLocker locker(&d->avatarMutex);
+        if( !d->avatarUrl.isValid() )
+            return QPixmap();
+        key = avatarKey(d->avatarUrl, size);
+        image = d->readyImages.take(key);
+    }
+
+    QPixmap avatar;
+    if( !image.isNull() )
+    {
+        avatar = QPixmap::fromImage(image);
+        avatarCache().insert(key, new QPixmap(avatar), image.width() * image.height());
+    }
+    else if( QPixmap* cached = avatarCache().object(key) )
+        avatar = *cached;
+    if( !avatar.isNull() )
+    {
+        QMutexLocker locker(&d->avatarMutex);
+        d->lastAvatar = avatar;
+        return avatar;
     }
 
-    if( d->avatar.isNull() )
-        return d->avatar;
-    QPair<int,int> size(width, height);
-    if( !d->scaledMap.contains(size) )
+    QMutexLocker locker(&d->avatarMutex);
+    if( !d->ongoingSizes.contains(qMakePair(width, height)) )
     {
-        d->scaledMap.insert(size, d->avatar.scaled(width, height, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+        qDebug() << "Getting avatar for" << id() << "in" << size;
+        d->ongoingSizes.insert(qMakePair(width, height));
+        d->pendingSizes.append(size);
+        // Jobs are started in the thread of the connection
+        QMetaObject::invokeMethod(this, "requestAvatar", Qt::QueuedConnection);
     }
-    return d->scaledMap.value(size);
+    return d->lastAvatar;
+}
+
+void User::setAvatarCacheLimit(int pixels)
+{
+    avatarCache().setMaxCost(pixels);
 }
 
 void User::processEvent(Event* event)
@@ -116,10 +162,14 @@ void User::processEvent(Event* event)
             d->name = e->displayName();
             emit nameChanged(this, oldName);
         }
+        QMutexLocker locker(&d->avatarMutex);
         if( d->avatarUrl != e->avatarUrl() )
         {
+            // Avatars of the old URL stay in the cache for other users
+            // that may have it, until they get evicted
             d->avatarUrl = e->avatarUrl();
-            d->avatarValid = false;
+            d->ongoingSizes.clear();
+            d->readyImages.clear();
         }
     }
 }
@@ -131,14 +181,34 @@ void User::requestAvatar()
 
 void User::Private::requestAvatar()
 {
-    MediaThumbnailJob* job =
-            connection->getThumbnail(avatarUrl, requestedWidth, requestedHeight);
-    connect( job, &MediaThumbnailJob::success, [=]() {
-        avatarOngoingRequest = false;
-        avatarValid = true;
-        avatar = job->thumbnail().scaled(requestedWidth, requestedHeight,
-                        Qt::KeepAspectRatio, Qt::SmoothTransformation);
-        scaledMap.clear();
-        emit q->avatarChanged(q);
-    });
+    QUrl url;
+    QList<QSize> sizes;
+    {
+        QMutexLocker locker(&avatarMutex);
+        url = avatarUrl;
+        sizes.swap(pendingSizes);
+    }
+    for( const QSize& size: sizes )
+    {
+        // Sizes near each other share one download, see
+        // MediaThumbnailJob::thumbnail(); the job scales to the exact size
+        MediaThumbnailJob* job =
+            connection->getThumbnail(url, size.width(), size.height());
+        // The job may be shared with other users and outlive this one
+        connect( job, &MediaThumbnailJob::success, q, [=]() {
+            {
+                QMutexLocker locker(&avatarMutex);
+                if( url != avatarUrl )
+                    return;
+                readyImages.insert(avatarKey(url, size), job->thumbnailImage());
+            }
+            emit q->avatarChanged(q);
+        });
+        // Failed and killed requests can be made again
+        connect( job, &KJob::finished, q, [=]() {
+            QMutexLocker locker(&avatarMutex);
+            if( url == avatarUrl )
+                ongoingSizes.remove(qMakePair(size.width(), size.height()));
+        });
+    }
 }
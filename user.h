@@ -48,8 +48,27 @@ namespace QMatrixClient
              */
             Q_INVOKABLE QString displayname() const;
 
+            /**
+             * Returns the avatar scaled to fit the size. Avatars not
+             * there yet are requested, and the last avatar returned (of
+             * another size) is returned meanwhile; avatarChanged() is
+             * emitted when one arrives. Requests for similar sizes share
+             * one download (see MediaThumbnailJob::thumbnail()), and the
+             * scaling is done by the job on a worker thread. Avatars of
+             * all users are kept in one cache, see setAvatarCacheLimit().
+             * To be called from the GUI thread; the connection may work
+             * in a thread of its own.
+             */
             QPixmap avatar(int requestedWidth, int requestedHeight);
 
+            /**
+             * Sets the limit of the avatar cache shared by all users, in
+             * pixels; the least recently used avatars are dropped to fit
+             * it. The default is 4M pixels (16 MB in 32 bit colour).
+             * To be called from the GUI thread.
+             */
+            static void setAvatarCacheLimit(int pixels);
+
             void processEvent(Event* event);
 
         public slots: